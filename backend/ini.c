@@ -127,22 +127,35 @@ static void
 processFileEvent (unsigned int watchId,
 		  void         *closure)
 {
-    IniPrivData *data = (IniPrivData *) closure;
-    char        *fileName;
+    IniPrivData   *data = (IniPrivData *) closure;
+    IniDictionary *oldFile;
+    char          *fileName;
 
     /* our ini file has been modified, reload it */
 
-    if (data->iniFile)
-	ccsIniClose (data->iniFile);
+    oldFile = data->iniFile;
 
     fileName = getIniFileName (data->lastProfile);
 
     if (!fileName)
+    {
+	if (oldFile)
+	    ccsIniClose (oldFile);
+
+	data->iniFile = NULL;
 	return;
+    }
 
     data->iniFile = ccsIniOpen (fileName);
 
-    ccsReadSettings (data->context);
+    /* only re-read the settings whose entries were changed */
+    if (oldFile && data->iniFile)
+	ccsIniReadChangedSettings (data->context, oldFile, data->iniFile);
+    else
+	ccsReadSettings (data->context);
+
+    if (oldFile)
+	ccsIniClose (oldFile);
 
     free (fileName);
 }
@@ -332,124 +345,16 @@ static void
 writeSetting (CCSContext *context,
 	      CCSSetting *setting)
 {
-    char        *keyName;
     IniPrivData *data;
 
     data = findPrivFromContext (context);
     if (!data)
 	return;
 
-    if (setting->isScreen)
-	keyName = strdup_printf ("s%d_%s", setting->screenNum, setting->name);
-    else
-	keyName = strdup_printf ("as_%s", setting->name);
-
-    if (keyName == NULL)
-	return;
-
     if (setting->isDefault)
-    {
-	ccsIniRemoveEntry (data->iniFile, setting->parent->name, keyName);
-	free (keyName);
-	return;
-    }
-
-    switch (setting->type)
-    {
-    case TypeString:
-	{
-	    char *value;
-	    if (ccsGetString (setting, &value))
-		ccsIniSetString (data->iniFile, setting->parent->name,
-				 keyName, value);
-	}
-	break;
-    case TypeMatch:
-	{
-	    char *value;
-	    if (ccsGetMatch (setting, &value))
-		ccsIniSetString (data->iniFile, setting->parent->name,
-				 keyName, value);
-	}
-	break;
-    case TypeInt:
-	{
-	    int value;
-	    if (ccsGetInt (setting, &value))
-		ccsIniSetInt (data->iniFile, setting->parent->name,
-			      keyName, value);
-	}
-	break;
-    case TypeFloat:
-	{
-	    float value;
-	    if (ccsGetFloat (setting, &value))
-		ccsIniSetFloat (data->iniFile, setting->parent->name,
-				keyName, value);
-	}
-	break;
-    case TypeBool:
-	{
-	    Bool value;
-	    if (ccsGetBool (setting, &value))
-		ccsIniSetBool (data->iniFile, setting->parent->name,
-			       keyName, value);
-	}
-	break;
-    case TypeColor:
-	{
-	    CCSSettingColorValue value;
-	    if (ccsGetColor (setting, &value))
-		ccsIniSetColor (data->iniFile, setting->parent->name,
-				keyName, value);
-	}
-	break;
-    case TypeKey:
-	{
-	    CCSSettingKeyValue value;
-	    if (ccsGetKey (setting, &value))
-		ccsIniSetKey (data->iniFile, setting->parent->name,
-			      keyName, value);
-	}
-	break;
-    case TypeButton:
-	{
-	    CCSSettingButtonValue value;
-	    if (ccsGetButton (setting, &value))
-		ccsIniSetButton (data->iniFile, setting->parent->name,
-				 keyName, value);
-	}
-	break;
-    case TypeEdge:
-	{
-	    unsigned int value;
-	    if (ccsGetEdge (setting, &value))
-		ccsIniSetEdge (data->iniFile, setting->parent->name,
-			       keyName, value);
-	}
-	break;
-    case TypeBell:
-	{
-	    Bool value;
-	    if (ccsGetBell (setting, &value))
-		ccsIniSetBell (data->iniFile, setting->parent->name,
-			       keyName, value);
-	}
-	break;
-    case TypeList:
-	{
-	    CCSSettingValueList value;
-	    if (ccsGetList (setting, &value))
-		ccsIniSetList (data->iniFile, setting->parent->name,
-			       keyName, value, setting->info.forList.listType);
-	}
-	break;
-    default:
-	break;
-    }
-
-    if (keyName)
-	free (keyName);
+	ccsIniRemoveSetting (data->iniFile, setting);
+    else
+	ccsIniWriteSetting (data->iniFile, setting);
 }
 
 static void
@@ -477,6 +382,9 @@ writeDone (CCSContext * context)
 
     ccsIniSave (data->iniFile, fileName);
 
+    /* nothing points into the dictionary between writes */
+    ccsIniCompact (data->iniFile);
+
     ccsEnableFileWatch (data->iniWatchId);
 
     free (fileName);
@@ -0,0 +1,279 @@
+/*
+ * Compiz configuration system library
+ *
+ * Copyright (C) 2026  The Compiz Reloaded Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* Memory and time taken by loading the settings of synthetic plugins
+   with 1, 4 and 16 screens. Every screen count is measured in its own
+   process:
+
+   ccs-bench-screens [plugins] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <ccs.h>
+
+#include "synthetic.h"
+
+#define NUM_TYPES 12
+
+static const char *optionTypes[NUM_TYPES] = {
+    "bool", "int", "float", "string", "color", "key",
+    "button", "edge", "bell", "match", "list", "list"
+};
+
+static void
+writeOptions (FILE       *f,
+	      const char *prefix,
+	      int        count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+	const char *type = optionTypes[i % NUM_TYPES];
+
+	fprintf (f, "<option name=\"%s_%d\" type=\"%s\">"
+		 "<short>Short %s %d</short>"
+		 "<short xml:lang=\"de\">Kurz %s %d</short>"
+		 "<long>Long description %d</long>",
+		 prefix, i, type, prefix, i, prefix, i, i);
+
+	switch (i % NUM_TYPES)
+	{
+	case 0:
+	    fprintf (f, "<default>true</default>");
+	    break;
+	case 1:
+	    fprintf (f, "<min>0</min><max>100</max><default>%d</default>"
+		     "<desc><value>1</value><name>One</name></desc>", i);
+	    break;
+	case 2:
+	    fprintf (f, "<min>0.0</min><max>10.0</max>"
+		     "<precision>0.1</precision><default>1.5</default>");
+	    break;
+	case 3:
+	    fprintf (f, "<default>str%d</default><restriction><value>a"
+		     "</value><name>A</name></restriction>", i);
+	    break;
+	case 4:
+	    fprintf (f, "<default><red>0xffff</red><green>0x1000</green>"
+		     "</default>");
+	    break;
+	case 5:
+	    fprintf (f, "<default>&lt;Control&gt;a</default>");
+	    break;
+	case 6:
+	    fprintf (f, "<default>&lt;Alt&gt;Button1</default>");
+	    break;
+	case 7:
+	    fprintf (f, "<default><edge name=\"Left\"/></default>");
+	    break;
+	case 8:
+	    fprintf (f, "<default>false</default>");
+	    break;
+	case 9:
+	    fprintf (f, "<default>type=Normal</default>");
+	    break;
+	case 10:
+	    fprintf (f, "<type>string</type><default><value>x</value>"
+		     "<value>y</value></default>");
+	    break;
+	default:
+	    fprintf (f, "<type>int</type><min>0</min><max>9</max><default>"
+		     "<value>1</value><value>2</value></default>");
+	    break;
+	}
+
+	fprintf (f, "</option>\n");
+    }
+}
+
+/* 15 display and 15 screen options per plugin */
+static Bool
+writePlugins (const char *home,
+	      int        numPlugins)
+{
+    char name[64];
+    FILE *f;
+    int  p;
+
+    for (p = 0; p < numPlugins; p++)
+    {
+	snprintf (name, sizeof (name), "screens%d", p);
+
+	f = benchMetadataOpen (home, name);
+	if (!f)
+	    return FALSE;
+
+	fprintf (f, "<compiz><plugin name=\"%s\"><short>Plugin %d</short>"
+		 "<long>Synthetic plugin %d</long><category>Cat%d</category>"
+		 "<display><group><short>General</short><subgroup>"
+		 "<short>Main</short>\n", name, p, p, p % 3);
+	writeOptions (f, "d", 10);
+	fprintf (f, "</subgroup></group><group><short>Advanced</short>\n");
+	writeOptions (f, "e", 5);
+	fprintf (f, "</group></display><screen><group><short>General"
+		 "</short>\n");
+	writeOptions (f, "s", 12);
+	fprintf (f, "</group>\n");
+	writeOptions (f, "t", 3);
+	fprintf (f, "</screen></plugin></compiz>\n");
+
+	fclose (f);
+    }
+
+    return TRUE;
+}
+
+/* Heap in use, or 0 if the C library can't tell */
+static size_t
+heapInUse (void)
+{
+#if defined (__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2 ().uordblks;
+#else
+    return 0;
+#endif
+}
+
+static int
+measure (int numPlugins,
+	 int numScreens)
+{
+    unsigned int   *screens;
+    unsigned int   numSettings = 0;
+    CCSContext     *context;
+    CCSPluginList  pl;
+    struct rusage  usage;
+    char           name[64];
+    char           *home;
+    size_t         heap;
+    double         time;
+    long           rss;
+    int            i;
+
+    home = benchHomeNew ();
+    if (!home)
+	return 1;
+
+    if (!writePlugins (home, numPlugins))
+    {
+	benchHomeFree (home);
+	return 1;
+    }
+
+    screens = malloc (numScreens * sizeof (unsigned int));
+    if (!screens)
+    {
+	benchHomeFree (home);
+	return 1;
+    }
+
+    for (i = 0; i < numScreens; i++)
+	screens[i] = i;
+
+    getrusage (RUSAGE_SELF, &usage);
+    rss = usage.ru_maxrss;
+    heap = heapInUse ();
+    time = benchNow ();
+
+    context = ccsEmptyContextNew (screens, numScreens);
+    if (!context)
+    {
+	free (screens);
+	benchHomeFree (home);
+	return 1;
+    }
+
+    for (i = 0; i < numPlugins; i++)
+    {
+	snprintf (name, sizeof (name), "screens%d", i);
+	ccsLoadPlugin (context, name);
+    }
+
+    for (pl = context->plugins; pl; pl = pl->next)
+	numSettings += ccsSettingListLength (ccsGetPluginSettings (pl->data));
+
+    time = benchNow () - time;
+    heap = heapInUse () - heap;
+    getrusage (RUSAGE_SELF, &usage);
+    rss = usage.ru_maxrss - rss;
+
+    printf ("%2d screens: %6u settings, %9.1f KiB heap, "
+	    "%9ld KiB peak RSS, %7.1f ms\n",
+	    numScreens, numSettings, heap / 1024.0, rss, time);
+
+    ccsContextDestroy (context);
+    free (screens);
+    benchHomeFree (home);
+
+    return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+    static const int numScreens[] = { 1, 4, 16 };
+    int numPlugins = 200;
+    unsigned int i;
+
+    if (argc > 1)
+	numPlugins = atoi (argv[1]);
+
+    if (numPlugins <= 0)
+    {
+	fprintf (stderr, "usage: %s [plugins]\n", argv[0]);
+	return 1;
+    }
+
+    printf ("%d synthetic plugins, XML metadata\n", numPlugins);
+    fflush (stdout);
+
+    for (i = 0; i < sizeof (numScreens) / sizeof (numScreens[0]); i++)
+    {
+	pid_t pid = fork ();
+	int   status;
+
+	if (pid < 0)
+	{
+	    perror ("fork");
+	    return 1;
+	}
+
+	if (!pid)
+	    exit (measure (numPlugins, numScreens[i]));
+
+	if (waitpid (pid, &status, 0) < 0 ||
+	    !WIFEXITED (status) || WEXITSTATUS (status))
+	{
+	    fprintf (stderr, "measuring %d screens failed\n", numScreens[i]);
+	    return 1;
+	}
+    }
+
+    return 0;
+}
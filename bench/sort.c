@@ -0,0 +1,227 @@
+/*
+ * Compiz configuration system library
+ *
+ * Copyright (C) 2026  The Compiz Reloaded Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* Time taken by ccsGetSortedPluginStringList for active synthetic
+   plugins with random, but satisfiable, load order relations. The last
+   plugin is bench, which has to come last. Prints the median of 15
+   rounds of calls:
+
+   ccs-bench-sort [plugins [calls per round [seed]]] */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ccs.h>
+
+#include "synthetic.h"
+
+#define ROUNDS 15
+
+static void
+pluginName (char *name,
+	    size_t size,
+	    int    numPlugins,
+	    int    i)
+{
+    if (i == numPlugins - 1)
+	snprintf (name, size, "bench");
+    else
+	snprintf (name, size, "sort%d", i);
+}
+
+/* Every plugin gets a hidden rank, and a relation always puts the plugin
+   of lower rank first, so the relations never form a cycle. Some plugins
+   also load after a missing plugin, or require a plugin they have to be
+   loaded before, which the sort ignores. */
+static Bool
+writePlugins (const char *home,
+	      int        numPlugins)
+{
+    int  *rank;
+    char name[64], other[64];
+    FILE *f;
+    int  i, j, k, n;
+
+    rank = malloc (numPlugins * sizeof (int));
+    if (!rank)
+	return FALSE;
+
+    for (i = 0; i < numPlugins; i++)
+	rank[i] = i;
+
+    for (i = numPlugins - 1; i > 0; i--)
+    {
+	j = benchRandom () % (i + 1);
+	k = rank[i];
+	rank[i] = rank[j];
+	rank[j] = k;
+    }
+
+    for (i = 0; i < numPlugins; i++)
+    {
+	pluginName (name, sizeof (name), numPlugins, i);
+
+	f = benchMetadataOpen (home, name);
+	if (!f)
+	{
+	    free (rank);
+	    return FALSE;
+	}
+
+	fprintf (f, "<compiz><plugin name=\"%s\"><short>%s</short><deps>",
+		 name, name);
+
+	n = (i == numPlugins - 1) ? 0 : benchRandom () % 5;
+	for (k = 0; k < n; k++)
+	{
+	    j = benchRandom () % (numPlugins - 1);
+	    if (j == i)
+		continue;
+
+	    pluginName (other, sizeof (other), numPlugins, j);
+
+	    if (rank[j] > rank[i])
+		fprintf (f, "<relation type=\"before\"><plugin>%s</plugin>"
+			 "</relation>", other);
+	    else if (benchRandom () % 3)
+		fprintf (f, "<relation type=\"after\"><plugin>%s</plugin>"
+			 "</relation>", other);
+	    else
+		fprintf (f, "<requirement><plugin>%s</plugin></requirement>",
+			 other);
+
+	    if (rank[j] > rank[i] && benchRandom () % 20 == 0)
+		fprintf (f, "<requirement><plugin>%s</plugin></requirement>",
+			 other);
+	}
+
+	if (i != numPlugins - 1 && benchRandom () % 20 == 0)
+	    fprintf (f, "<relation type=\"after\"><plugin>missing%d</plugin>"
+		     "</relation>", i);
+
+	fprintf (f, "</deps></plugin></compiz>\n");
+	fclose (f);
+    }
+
+    free (rank);
+
+    return TRUE;
+}
+
+static int
+compareTimes (const void *a,
+	      const void *b)
+{
+    double ta = *(const double *) a, tb = *(const double *) b;
+
+    return (ta > tb) - (ta < tb);
+}
+
+int
+main (int argc, char **argv)
+{
+    int           numPlugins = 300, calls = 100;
+    unsigned int  seed = 1;
+    double        times[ROUNDS];
+    CCSContext    *context;
+    CCSPluginList pl;
+    CCSStringList sorted;
+    char          name[64];
+    char          *home;
+    int           i, r, numSorted;
+
+    if (argc > 1)
+	numPlugins = atoi (argv[1]);
+    if (argc > 2)
+	calls = atoi (argv[2]);
+    if (argc > 3)
+	seed = strtoul (argv[3], NULL, 10);
+
+    if (numPlugins < 2 || calls <= 0)
+    {
+	fprintf (stderr, "usage: %s [plugins [calls per round [seed]]]\n",
+		 argv[0]);
+	return 1;
+    }
+
+    benchRandomSeed (seed);
+
+    home = benchHomeNew ();
+    if (!home)
+	return 1;
+
+    if (!writePlugins (home, numPlugins))
+    {
+	benchHomeFree (home);
+	return 1;
+    }
+
+    context = ccsEmptyContextNew (NULL, 0);
+    if (!context)
+    {
+	benchHomeFree (home);
+	return 1;
+    }
+
+    ccsSetPluginListAutoSort (context, FALSE);
+
+    for (i = 0; i < numPlugins; i++)
+    {
+	pluginName (name, sizeof (name), numPlugins, i);
+	ccsLoadPlugin (context, name);
+    }
+
+    for (pl = context->plugins; pl; pl = pl->next)
+	ccsPluginSetActive (pl->data, TRUE);
+
+    /* core is always put first */
+    sorted = ccsGetSortedPluginStringList (context);
+    numSorted = ccsStringListLength (sorted) - 1;
+    ccsStringListFree (sorted, TRUE);
+
+    if (numSorted != numPlugins)
+    {
+	fprintf (stderr, "sorted %d of %d plugins\n", numSorted, numPlugins);
+	ccsContextDestroy (context);
+	benchHomeFree (home);
+	return 1;
+    }
+
+    for (r = 0; r < ROUNDS; r++)
+    {
+	double time = benchNow ();
+
+	for (i = 0; i < calls; i++)
+	    ccsStringListFree (ccsGetSortedPluginStringList (context), TRUE);
+
+	times[r] = (benchNow () - time) / calls;
+    }
+
+    qsort (times, ROUNDS, sizeof (double), compareTimes);
+
+    printf ("%d synthetic plugins, seed %u: %.4f ms per sort (median of "
+	    "%d rounds of %d calls)\n",
+	    numPlugins, seed, times[ROUNDS / 2], ROUNDS, calls);
+
+    ccsContextDestroy (context);
+    benchHomeFree (home);
+
+    return 0;
+}
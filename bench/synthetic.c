@@ -0,0 +1,125 @@
+/*
+ * Compiz configuration system library
+ *
+ * Copyright (C) 2026  The Compiz Reloaded Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+#include <string.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include "synthetic.h"
+
+static unsigned int randomState = 1;
+
+char *
+benchHomeNew (void)
+{
+    char template[] = "/tmp/ccs-bench-XXXXXX";
+    char path[1024];
+    char *home;
+
+    home = mkdtemp (template);
+    if (!home)
+    {
+	perror ("mkdtemp");
+	return NULL;
+    }
+
+    snprintf (path, sizeof (path), "%s/.compiz", home);
+    mkdir (path, 0700);
+    snprintf (path, sizeof (path), "%s/.compiz/metadata", home);
+    if (mkdir (path, 0700))
+    {
+	perror (path);
+	return NULL;
+    }
+
+    setenv ("HOME", home, 1);
+    setenv ("XDG_CONFIG_HOME", home, 1);
+    setenv ("COMPIZ_NO_PROTOBUF", "1", 1);
+
+    return strdup (home);
+}
+
+static int
+removeEntry (const char        *path,
+	     const struct stat *sb,
+	     int               type,
+	     struct FTW        *ftw)
+{
+    return remove (path);
+}
+
+void
+benchHomeFree (char *home)
+{
+    if (!home)
+	return;
+
+    nftw (home, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+    free (home);
+}
+
+FILE *
+benchMetadataOpen (const char *home,
+		   const char *plugin)
+{
+    char path[1024];
+    FILE *f;
+
+    snprintf (path, sizeof (path), "%s/.compiz/metadata/%s.xml",
+	      home, plugin);
+
+    f = fopen (path, "w");
+    if (!f)
+	perror (path);
+
+    return f;
+}
+
+unsigned int
+benchRandom (void)
+{
+    /* xorshift32 */
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+void
+benchRandomSeed (unsigned int seed)
+{
+    randomState = seed ? seed : 1;
+}
+
+double
+benchNow (void)
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
@@ -0,0 +1,50 @@
+/*
+ * Compiz configuration system library
+ *
+ * Copyright (C) 2026  The Compiz Reloaded Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _BENCH_SYNTHETIC_H
+#define _BENCH_SYNTHETIC_H
+
+#include <stdio.h>
+
+/* The benchmarks write synthetic plugin metadata to ~/.compiz/metadata
+   of a temporary home directory, which ccsLoadPlugin searches first.
+   Protobuf caching is disabled, so every run parses the same XML. */
+
+/* Creates the home directory and points HOME at it, returns its path or
+   NULL on failure */
+char *benchHomeNew (void);
+
+/* Removes the home directory with everything in it */
+void benchHomeFree (char *home);
+
+/* Opens <plugin>.xml in the metadata directory of home for writing */
+FILE *benchMetadataOpen (const char *home,
+			 const char *plugin);
+
+/* Returns the next number of a fixed pseudo random sequence, so that
+   every run and platform gets the same metadata */
+unsigned int benchRandom (void);
+
+void benchRandomSeed (unsigned int seed);
+
+/* Milliseconds since some fixed point in time */
+double benchNow (void);
+
+#endif
@@ -106,6 +106,7 @@ typedef struct _CCSSubGroup	  CCSSubGroup;
 typedef struct _CCSPluginCategory CCSPluginCategory;
 typedef struct _CCSSettingValue	  CCSSettingValue;
 typedef struct _CCSPluginConflict CCSPluginConflict;
+typedef struct _CCSPluginConflictStatus CCSPluginConflictStatus;
 typedef struct _CCSBackendInfo	  CCSBackendInfo;
 typedef struct _CCSIntDesc	  CCSIntDesc;
 typedef struct _CCSStrRestriction CCSStrRestriction;
@@ -118,6 +119,7 @@ CCSLIST_HDR (Group, CCSGroup)
 CCSLIST_HDR (SubGroup, CCSSubGroup)
 CCSLIST_HDR (SettingValue, CCSSettingValue)
 CCSLIST_HDR (PluginConflict, CCSPluginConflict)
+CCSLIST_HDR (PluginConflictStatus, CCSPluginConflictStatus)
 CCSLIST_HDR (BackendInfo, CCSBackendInfo)
 CCSLIST_HDR (IntDesc, CCSIntDesc)
 CCSLIST_HDR (StrRestriction, CCSStrRestriction)
@@ -134,7 +136,15 @@ struct _CCSContext
 					  internal usage */
 
     CCSSettingList    changedSettings; /* list of settings changed since last
-					  settings write */
+					  settings write, in change order,
+					  each setting at most once. Brought
+					  up to date by ccsGetChangedSettings,
+					  ccsProcessEvents and
+					  ccsRead*Settings; may be cleared,
+					  replaced or taken over. Settings
+					  added to it in place are written,
+					  removing them in place may not stop
+					  their write */
 
     unsigned int      *screens;        /* numbers of the available screens */
     unsigned int      numScreens;      /* number of screens */
@@ -149,14 +159,19 @@ struct _CCSBackendInfo
     Bool profileSupport;     /* does the backend support profiles? */
 };
 
+/* Strings marked "shared" below are kept once per context in a string
+   pool and freed with the context. They must not be freed or modified,
+   and ccsFree* functions don't free them. */
+
 struct _CCSPlugin
 {
     char *name;                    /* plugin name */
     char *shortDesc;		   /* plugin short description */
     char *longDesc;		   /* plugin long description */
     char *hints;                   /* currently unused */
-    char *category;		   /* plugin category name */
+    char *category;		   /* plugin category name, shared */
 
+    /* the strings of the following lists are shared, the lists are not */
     CCSStringList loadAfter;       /* list of plugin names this plugin needs to
 				      be loaded after */
     CCSStringList loadBefore;      /* list of plugin names this plugin needs to
@@ -200,13 +215,14 @@ typedef enum _CCSSettingType
 
 struct _CCSSubGroup
 {
-    char           *name;    /* sub group name in current locale */
+    char           *name;    /* sub group name in current locale,
+				shared */
     CCSSettingList settings; /* list of settings in this sub group */
 };
 
 struct _CCSGroup
 {
-    char            *name;     /* group name in current locale */
+    char            *name;     /* group name in current locale, shared */
     CCSSubGroupList subGroups; /* list of sub groups in this group */
 };
 
@@ -231,6 +247,15 @@ struct _CCSPluginConflict
     CCSPluginList         plugins; /* list of conflicting plugins */
 };
 
+struct _CCSPluginConflictStatus
+{
+    CCSPlugin             *plugin;
+    Bool                  active;    /* plugin is currently active */
+    CCSPluginConflictList conflicts; /* conflicts on disabling the plugin
+					if it is active, on enabling it
+					otherwise */
+};
+
 union _CCSSettingInfo;
 
 struct _CCSIntDesc
@@ -248,7 +273,8 @@ struct _CCSStrRestriction
 struct _CCSStrExtension
 {
     char *basePlugin;           /* plugin this extension extends */
-    CCSStringList baseSettings; /* list of settings this extension extends */
+    CCSStringList baseSettings; /* list of settings this extension extends,
+				   its strings are shared */
     CCSStrRestrictionList restriction; /* list of added restriction items */
 
     Bool isScreen;          /* is this extension a screen setting extension? */
@@ -359,8 +385,10 @@ struct _CCSSettingValue
 struct _CCSSetting
 {
     char *name;             /* setting name */
-    char *shortDesc;        /* setting short description in current locale */
-    char *longDesc;         /* setting long description in current locale */
+    char *shortDesc;        /* setting short description in current locale,
+			       shared */
+    char *longDesc;         /* setting long description in current locale,
+			       shared */
 
     CCSSettingType type;    /* setting type */
 
@@ -372,9 +400,9 @@ struct _CCSSetting
 			       valid if the setting is an int, float, string
 			       or list setting */
 
-    char *group;	    /* group name in current locale */
-    char *subGroup;	    /* sub group name in current locale */
-    char *hints;	    /* hints in current locale */
+    char *group;	    /* group name in current locale, shared */
+    char *subGroup;	    /* sub group name in current locale, shared */
+    char *hints;	    /* hints in current locale, shared */
 
     CCSSettingValue defaultValue; /* default value of this setting */
     CCSSettingValue *value;       /* actual value of this setting */
@@ -383,6 +411,9 @@ struct _CCSSetting
 
     CCSPlugin *parent;            /* plugin this setting belongs to */
     void      *privatePtr;        /* private pointer for usage by the caller */
+
+    void      *ccsPrivate;        /* private data for compizconfig internal
+				     usage */
 };
 
 struct _CCSPluginCategory
@@ -398,6 +429,17 @@ struct _CCSPluginCategory
    metadata informations will be parsed */
 void ccsSetBasicMetadata (Bool value);
 
+/* set eager metadata to TRUE and the options of all plugins will be
+   parsed while the plugins are enumerated, instead of reading their
+   metadata files again when their settings are loaded */
+void ccsSetEagerMetadata (Bool value);
+
+/* set lazy descriptions to TRUE and the localized short and long
+   descriptions of settings are only read when ccsSettingGetShortDesc or
+   ccsSettingGetLongDesc asks for them. Until then the shortDesc and
+   longDesc fields hold the setting name and an empty string */
+void ccsSetLazyDescriptions (Bool value);
+
 /* Creates a new context for the screens given in screens and numScreens.
    Set numScreens to 0 to initialize for all screens.
    All plugin settings are automatically enumerated. */
@@ -436,6 +478,9 @@ CCSSetting* ccsFindSetting (CCSPlugin    *plugin,
 Bool ccsPluginIsActive (CCSContext *context,
 			char       *name);
 
+/* Shared strings are left to the context: ccsFreePlugin, ccsFreeSetting,
+   ccsFreeGroup, ccsFreeSubGroup and ccsFreeStrExtension don't free them,
+   ccsFreeContext frees all of them along with the string pool. */
 void ccsFreeContext (CCSContext *context);
 void ccsFreePlugin (CCSPlugin *plugin);
 void ccsFreeSetting (CCSSetting *setting);
@@ -443,6 +488,7 @@ void ccsFreeGroup (CCSGroup *group);
 void ccsFreeSubGroup (CCSSubGroup *subGroup);
 void ccsFreeSettingValue (CCSSettingValue *value);
 void ccsFreePluginConflict (CCSPluginConflict *value);
+void ccsFreePluginConflictStatus (CCSPluginConflictStatus *value);
 void ccsFreeBackendInfo (CCSBackendInfo *value);
 void ccsFreeIntDesc (CCSIntDesc *value);
 void ccsFreeStrRestriction (CCSStrRestriction *restriction);
@@ -452,7 +498,8 @@ void ccsFreeStrExtension (CCSStrExtension *extension);
 
 /* Setting setters. Set <setting> to value <data>. Return TRUE if new value
    matches data. If the new value doesn't match the old value, the setting
-   is added to the context's changedSettings list. */
+   is recorded as changed unless it is already, see ccsGetChangedSettings.
+   */
 Bool ccsSetInt (CCSSetting *setting,
 		int        data);
 Bool ccsSetFloat (CCSSetting *setting,
@@ -512,12 +559,37 @@ Bool ccsGetBell (CCSSetting *setting,
 Bool ccsGetList (CCSSetting          *setting,
 		 CCSSettingValueList *data);
 
+/* Retrieve the list value of <setting> as an array of the list item type,
+   with the item count copied into <num>. The array belongs to the setting
+   and stays valid until the next change of the setting made through the
+   ccs API; repeated calls don't copy again. Editing the value of the
+   setting directly is not noticed. Return NULL (and 0 items) if the list is empty or of another
+   item type. String and match arrays point to the strings of the list. */
+const int* ccsGetIntListArray (CCSSetting *setting,
+			       int        *num);
+const float* ccsGetFloatListArray (CCSSetting *setting,
+				   int        *num);
+const Bool* ccsGetBoolListArray (CCSSetting *setting,
+				 int        *num);
+const CCSSettingColorValue* ccsGetColorListArray (CCSSetting *setting,
+						  int        *num);
+const char* const* ccsGetStringListArray (CCSSetting *setting,
+					  int        *num);
+const char* const* ccsGetMatchListArray (CCSSetting *setting,
+					 int        *num);
+
 /* Retrieves a list of settings in a plugin */
 CCSSettingList ccsGetPluginSettings (CCSPlugin *plugin);
 
 /* Retrieves a list of setting groups in a plugin */
 CCSGroupList ccsGetPluginGroups (CCSPlugin *plugin);
 
+/* Retrieve the short and long description of a setting, reading the
+   descriptions of all settings of its plugin if they were left out
+   because of lazy descriptions. The strings belong to the context. */
+const char *ccsSettingGetShortDesc (CCSSetting *setting);
+const char *ccsSettingGetLongDesc (CCSSetting *setting);
+
 /* Converts a string list into a list of string settings.
    Return value needs to be freed by the caller. */
 CCSSettingValueList ccsGetValueListFromStringList (CCSStringList list,
@@ -660,11 +732,30 @@ void ccsReadPluginSettings (CCSPlugin *plugin);
 /* Write all settings to disk */
 void ccsWriteSettings (CCSContext *context);
 
+/* Brings the changedSettings list of the context up to date with the
+   settings changed since the last write and returns it */
+CCSSettingList ccsGetChangedSettings (CCSContext *context);
+
 /* Write changed settings to disk */
 void ccsWriteChangedSettings (CCSContext *context);
 
+/* Enables or disables deferred writing. While enabled,
+   ccsWriteChangedSettings only queues the changed settings, and they are
+   written together once delay milliseconds passed since the first queued
+   change (checked by ccsWriteChangedSettings and ccsProcessEvents), or
+   once threshold settings are queued. A threshold of 0 means no limit.
+   Disabling deferred writing flushes the queue. */
+void ccsSetDeferredWrites (CCSContext   *context,
+			   Bool         enable,
+			   unsigned int delay,
+			   unsigned int threshold);
+
+/* Writes settings queued by deferred writing to disk. This also happens
+   when the context is destroyed or its profile or backend changes. */
+void ccsFlushSettings (CCSContext *context);
+
 /* Reset all settings to defaults. Settings that were non-default
-   previously are added to the changedSettings list of the context. */
+   previously are recorded as changed, see ccsGetChangedSettings. */
 void ccsResetToDefault (CCSSetting * setting);
 
 /* Sets the current value as default value */
@@ -710,6 +801,8 @@ typedef struct _dictionary_
     char **key ;
     /** List of hash values for keys */
     unsigned *hash;
+    /** Private data for compizconfig internal usage (lookup index) */
+    void *ccsPrivate;
 } IniDictionary;
 
 IniDictionary* ccsIniNew (void);
@@ -718,6 +811,16 @@ void ccsIniClose (IniDictionary *dictionary);
 void ccsIniSave (IniDictionary *dictionary,
 		 const char    *fileName);
 
+/* Releases the storage left behind by changed and removed entries of a
+   dictionary once it outweighs the current entries. This moves all keys
+   and values, so strings returned by ccsIniIteratorNextSection and
+   ccsIniIteratorNextEntry before the call must not be used afterwards. */
+void ccsIniCompact (IniDictionary *dictionary);
+
+/* Sets whether ccsIniSave flushes files to disk before atomically
+   replacing the old file (default TRUE) */
+void ccsIniSetSyncOnSave (Bool sync);
+
 Bool ccsCreateDirFor (const char *fileName);
 
 Bool ccsIniGetString (IniDictionary *dictionary,
@@ -810,6 +913,40 @@ void ccsIniRemoveEntry (IniDictionary *dictionary,
 
 void ccsIniReadSetting (IniDictionary *dictionary,
 			CCSSetting *setting);
+void ccsIniWriteSetting (IniDictionary *dictionary,
+			 CCSSetting    *setting);
+void ccsIniRemoveSetting (IniDictionary *dictionary,
+			  CCSSetting    *setting);
+
+/* Re-reads the settings whose entries differ between two versions of the
+   same dictionary from the new one. Only plugins whose settings are
+   loaded are considered, other plugins read them once they get loaded. */
+void ccsIniReadChangedSettings (CCSContext    *context,
+				IniDictionary *oldDictionary,
+				IniDictionary *newDictionary);
+
+/* Iterates over the sections of an ini dictionary and the entries of each
+   section, in the order they were added. Initialize the iterator with
+   ccsIniIteratorInit, then call ccsIniIteratorNextSection and, for each
+   section returned, ccsIniIteratorNextEntry until they return FALSE.
+   Returned strings belong to the dictionary and must not be freed; they
+   stay valid until their entry is changed or removed, or ccsIniCompact
+   is called. Modifying the dictionary while iterating ends the current
+   section. */
+typedef struct _IniIterator
+{
+    IniDictionary *dictionary;
+    int           section;
+    int           entry;
+} IniIterator;
+
+void ccsIniIteratorInit (IniDictionary *dictionary,
+			 IniIterator   *iterator);
+Bool ccsIniIteratorNextSection (IniIterator *iterator,
+				const char  **section);
+Bool ccsIniIteratorNextEntry (IniIterator *iterator,
+			      const char  **entry,
+			      const char  **value);
 
 /* Checks if a plugin can be enabled. Returns a list of conflicts that
    would occur when loading the plugin. A return value of NULL means that
@@ -822,6 +959,12 @@ CCSPluginConflictList ccsCanEnablePlugin (CCSContext *context,
 CCSPluginConflictList ccsCanDisablePlugin (CCSContext *context,
 					   CCSPlugin *plugin);
 
+/* Checks all plugins of the context at once, e.g. to show which of them
+   can be toggled. Returns one entry per plugin in context->plugins order,
+   holding what ccsCanDisablePlugin returns for active plugins and what
+   ccsCanEnablePlugin returns for inactive ones. */
+CCSPluginConflictStatusList ccsGetPluginConflictStatus (CCSContext *context);
+
 /* Enumerates the available profiles for the current backend. */
 CCSStringList ccsGetExistingProfiles (CCSContext * context);
 
@@ -57,6 +57,8 @@ CCPCore;
 
 #define CCP_UPDATE_MIN_TIMEOUT 250
 #define CCP_UPDATE_MAX_TIMEOUT 4000
+#define CCP_WRITE_DELAY        1000
+#define CCP_WRITE_THRESHOLD    64
 #define CORE_VTABLE_NAME  "core"
 
 static void
@@ -740,6 +742,10 @@ ccpInitCore (CompPlugin *p,
     cc->context->changedSettings =
 	ccsSettingListFree (cc->context->changedSettings, FALSE);
 
+    /* coalesce option changes, they are flushed from ccpTimeout */
+    ccsSetDeferredWrites (cc->context, TRUE,
+			  CCP_WRITE_DELAY, CCP_WRITE_THRESHOLD);
+
     cc->applyingSettings = FALSE;
 
     cc->reloadHandle = compAddTimeout (0, 0, ccpReload, 0);
@@ -22,6 +22,9 @@
 #ifndef CCS_PRIVATE_H
 #define CSS_PRIVATE_H
 
+#include <sys/time.h>
+#include <pthread.h>
+
 #include <ccs.h>
 #include <ccs-backend.h>
 
@@ -29,8 +32,54 @@
     CCSContextPrivate *cPrivate = (CCSContextPrivate *) c->ccsPrivate;
 #define PLUGIN_PRIV(p) \
     CCSPluginPrivate *pPrivate = (CCSPluginPrivate *) p->ccsPrivate;
+#define SETTING_PRIV(s) \
+    CCSSettingPrivate *sPrivate = (CCSSettingPrivate *) s->ccsPrivate;
 
 extern Bool basicMetadata;
+extern Bool eagerMetadata;
+extern Bool lazyDescriptions;
+
+/* A list which also keeps track of its last node and its length, so
+   appending and counting don't need to walk it. head is a regular list
+   and can be handed out as is; an existing list is taken over with
+   ccs*SeqAdopt. A zeroed sequence is empty. */
+#define CCSSEQ_HDR(type,dtype) \
+    typedef struct _CCS##type##Seq \
+    { \
+	CCS##type##List head; \
+	CCS##type##List tail; \
+	unsigned int    length; \
+    } CCS##type##Seq; \
+    Bool ccs##type##SeqAppend (CCS##type##Seq *seq, dtype *data); \
+    void ccs##type##SeqAdopt (CCS##type##Seq *seq, CCS##type##List list); \
+    unsigned int ccs##type##SeqLength (CCS##type##Seq *seq); \
+    void ccs##type##SeqFree (CCS##type##Seq *seq, Bool freeObj);
+
+CCSSEQ_HDR (Plugin, CCSPlugin)
+CCSSEQ_HDR (Setting, CCSSetting)
+CCSSEQ_HDR (String, char)
+CCSSEQ_HDR (Group, CCSGroup)
+CCSSEQ_HDR (SubGroup, CCSSubGroup)
+CCSSEQ_HDR (SettingValue, CCSSettingValue)
+CCSSEQ_HDR (PluginConflict, CCSPluginConflict)
+CCSSEQ_HDR (PluginConflictStatus, CCSPluginConflictStatus)
+CCSSEQ_HDR (BackendInfo, CCSBackendInfo)
+CCSSEQ_HDR (IntDesc, CCSIntDesc)
+CCSSEQ_HDR (StrRestriction, CCSStrRestriction)
+CCSSEQ_HDR (StrExtension, CCSStrExtension)
+
+/* Reverse index of the plugin relations naming a plugin or feature,
+   used for the conflict checks. Lists are in context->plugins order. */
+typedef struct _CCSPluginRelations
+{
+    const char   *name;
+    CCSPluginSeq providers;	  /* plugins providing the feature name,
+				     once per mention */
+    CCSPluginSeq featureUsers;	  /* plugins requiring the feature name,
+				     once per mention */
+    CCSPluginSeq dependents;	  /* plugins requiring the plugin name */
+    unsigned int activeProviders; /* active entries in providers */
+} CCSPluginRelations;
 
 typedef struct _CCSContextPrivate
 {
@@ -41,13 +90,50 @@ typedef struct _CCSContextPrivate
     Bool              pluginListAutoSort;
 
     unsigned int      configWatchId;
+
+    Bool              deferWrites;
+    unsigned int      writeDelay;	/* in milliseconds */
+    unsigned int      writeThreshold;
+    CCSSettingSeq     pendingSettings;	/* changed, but not written yet */
+    struct timeval    pendingSince;
+
+    CCSSettingSeq     changedSettings;	/* changed since the last write */
+    unsigned int      changedEpoch;
+    CCSSettingList    publishedChanged;	/* last context->changedSettings */
+    Bool              changedStale;	/* changedSettings has more than the
+					   published list */
+
+    CCSPluginSeq      plugins;		/* tail of context->plugins */
+    CCSPlugin         **pluginIndex;	/* hash table of plugins by name */
+    unsigned int      pluginIndexSize;
+
+    CCSPluginRelations *relations;	/* hash table of plugin relations
+					   by plugin or feature name */
+    unsigned int      relationsSize;
+    unsigned int      relationsCount;
+    Bool              relationsValid;	/* built for the current plugins */
+
+    IniDictionary     *presets;		/* presets.ini, parsed on first use */
+    time_t            presetsTime;	/* its mtime when it was parsed */
+
+    char              **stringPool;	/* hash table of interned strings */
+    unsigned int      stringPoolSize;
+    unsigned int      stringPoolCount;
+    size_t            stringPoolSaved;	/* bytes not allocated because a
+					   string was already interned */
+    pthread_mutex_t   stringPoolLock;	/* plugins are loaded in parallel */
 } CCSContextPrivate;
 
 typedef struct _CCSPluginPrivate
 {
-    CCSSettingList settings;
-    CCSGroupList   groups;
+    CCSSettingSeq  settings;
+    CCSGroupList   groups;		/* built on first use */
+    Bool           groupsCollated;
     Bool 	   loaded;
+    Bool           optionsLoaded;	/* options were read while the plugin
+					   was enumerated */
+    Bool           descriptionsPending;	/* settings were added without
+					   their descriptions */
     Bool           active;
     char *	   xmlFile;
     char *	   xmlPath;
@@ -56,14 +142,51 @@ typedef struct _CCSPluginPrivate
 #endif
 
     CCSStrExtensionList stringExtensions;
+
+    CCSSetting     **settingIndex;	/* hash table of settings by name,
+					   isScreen and screenNum */
+    unsigned int   settingIndexSize;
+
+    CCSSetting     **iniKeyIndex;	/* hash table of settings by iniKey,
+					   built by the ini reader */
+    unsigned int   iniKeyIndexSize;
+    unsigned int   iniKeyIndexCount;	/* settings it was built from */
 } CCSPluginPrivate;
 
+typedef struct _CCSSettingPrivate
+{
+    char         *iniKey;	/* lowercase "plugin:sN_name", built on use */
+    unsigned int iniKeyHash;
+
+    unsigned int changedEpoch;	/* in changedSettings if equal to the
+				   context's changedEpoch */
+    Bool         pending;	/* in the context's pendingSettings */
+
+    void                *listArray;	/* contiguous copy of a list value,
+					   built by ccsGet*ListArray */
+    int                 listArrayLength;
+
+    CCSSetting *metadataOwner;	/* setting of another screen whose name,
+				   descriptions and info this one shares,
+				   NULL if it owns them */
+} CCSSettingPrivate;
+
 void ccsLoadPlugins (CCSContext * context);
+void ccsAddPluginToContext (CCSContext *context, CCSPlugin *plugin);
 void ccsLoadPluginSettings (CCSPlugin * plugin);
-void collateGroups (CCSPluginPrivate * p);
+void ccsLoadPluginDescriptions (CCSPlugin * plugin);
+void ccsAddSettingToPlugin (CCSPlugin *plugin, CCSSetting *setting);
+CCSSetting *ccsSettingNewForScreen (CCSSetting *setting,
+				    unsigned int screenNum);
+
+char *ccsInternString (CCSContext *context, const char *str);
+char *ccsInternOwnedString (CCSContext *context, char *str);
 
 void ccsCheckFileWatches (void);
 
+Bool ccsIniReadSettingValue (IniDictionary *dictionary,
+			     CCSSetting    *setting);
+
 typedef enum {
     OptionProfile,
     OptionBackend,
@@ -21,9 +21,11 @@
 #ifdef USE_PROTOBUF
 #include "compizconfig.pb.h"
 #include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <map>
 #endif
 
 #include <libxml/xpath.h>
+#include <libxml/xmlreader.h>
 
 extern "C"
 {
@@ -37,6 +39,9 @@ extern "C"
 #include <dirent.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 #include <locale.h>
 
@@ -78,9 +83,15 @@ typedef PluginMetadata::Option OptionMetadata;
 typedef PluginMetadata::Extension ExtensionMetadata;
 typedef OptionMetadata::GenericValue GenericValueMetadata;
 
+typedef metadata::Bundle BundleMetadata;
+typedef BundleMetadata::Source BundleSourceMetadata;
+typedef BundleMetadata::Directory BundleDirectoryMetadata;
+
+// Sources of the bundle by .xml path
+typedef std::map< std::string, const BundleSourceMetadata * > BundleIndex;
+
 typedef google::protobuf::RepeatedPtrField< std::string > StringList;
 
-PluginBriefMetadata persistentPluginBriefPB;
 PluginMetadata persistentPluginPB; // Made global so that it gets reused,
 					 // for better performance (to avoid
 					 // mem alloc/free for each plugin)
@@ -128,6 +139,31 @@ ccsAddRestrictionToStringExtension (CCSStrExtension *extension,
     }
 }
 
+/* adds the instances of the other screens for the screen setting just
+   built for the first one, sharing its metadata */
+static void
+addSettingForOtherScreens (CCSPlugin  *plugin,
+			   CCSSetting *setting)
+{
+    CCSContext *context = plugin->context;
+
+    for (unsigned i = 1; i < context->numScreens; i++)
+    {
+	CCSSetting *s;
+
+	if (ccsFindSetting (plugin, setting->name, TRUE, context->screens[i]))
+	{
+	    fprintf (stderr, "[ERROR]: Option \"%s\" already defined\n",
+		     setting->name);
+	    continue;
+	}
+
+	s = ccsSettingNewForScreen (setting, context->screens[i]);
+	if (s)
+	    ccsAddSettingToPlugin (plugin, s);
+    }
+}
+
 
 #ifdef USE_PROTOBUF
 
@@ -302,6 +338,7 @@ initListValuePB (CCSSettingValue * v,
 		 CCSSettingInfo * i,
 		 const OptionMetadata & option)
 {
+    CCSSettingValueSeq values = { NULL, NULL, 0 };
     int num, j;
 
     num = option.default_value_size ();
@@ -359,8 +396,10 @@ initListValuePB (CCSSettingValue * v,
 	    default:
 		break;
 	    }
-	    v->value.asList = ccsSettingValueListAppend (v->value.asList, val);
+	    ccsSettingValueSeqAppend (&values, val);
 	}
+
+	v->value.asList = values.head;
     }
 }
 
@@ -504,7 +543,7 @@ initActionInfoPB (CCSSettingInfo * i, const OptionMetadata & option)
 	i->forAction.internal = TRUE;
 }
 
-static void
+static CCSSetting *
 addOptionForPluginPB (CCSPlugin * plugin,
 		      const char * name,
 		      Bool isScreen,
@@ -513,17 +552,28 @@ addOptionForPluginPB (CCSPlugin * plugin,
 		      const StringList & subgroups,
 		      const OptionMetadata & option)
 {
-    CCSSetting *setting;
+    CCSContext        *context = plugin->context;
+    CCSSetting        *setting;
+    CCSSettingPrivate *sPrivate;
 
     if (ccsFindSetting (plugin, name, isScreen, screen))
     {
 	fprintf (stderr, "[ERROR]: Option \"%s\" already defined\n", name);
-	return;
+	return NULL;
     }
 
     setting = (CCSSetting *) calloc (1, sizeof (CCSSetting));
     if (!setting)
-	return;
+	return NULL;
+
+    sPrivate = (CCSSettingPrivate *) calloc (1, sizeof (CCSSettingPrivate));
+    if (!sPrivate)
+    {
+	free (setting);
+	return NULL;
+    }
+
+    setting->ccsPrivate = (void *) sPrivate;
 
     setting->parent = plugin;
     setting->isScreen = isScreen;
@@ -533,33 +583,44 @@ addOptionForPluginPB (CCSPlugin * plugin,
 
     if (!basicMetadata)
     {
-	setting->shortDesc =
-	    strdup (option.has_short_desc () ?
-		    option.short_desc ().c_str () :
-		    name);
-	setting->longDesc =
-	    strdup (option.has_long_desc () ?
-		    option.long_desc ().c_str () :
-		    name);
-	setting->hints = strdup (option.has_hints () ?
-				 option.hints ().c_str () :
+	if (lazyDescriptions)
+	{
+	    setting->shortDesc = ccsInternString (context, name);
+	    setting->longDesc  = ccsInternString (context, "");
+	    ((CCSPluginPrivate *) plugin->ccsPrivate)->descriptionsPending =
+		TRUE;
+	}
+	else
+	{
+	    setting->shortDesc =
+		ccsInternString (context, option.has_short_desc () ?
+				 option.short_desc ().c_str () :
+				 name);
+	    setting->longDesc =
+		ccsInternString (context, option.has_long_desc () ?
+				 option.long_desc ().c_str () :
 				 name);
+	}
+	setting->hints =
+	    ccsInternString (context, option.has_hints () ?
+			     option.hints ().c_str () :
+			     name);
 	setting->group =
-	    strdup (option.group_id () >= 0 ?
-		    groups.Get (option.group_id ()).c_str () :
-		    "");
+	    ccsInternString (context, option.group_id () >= 0 ?
+			     groups.Get (option.group_id ()).c_str () :
+			     "");
 	setting->subGroup =
-	    strdup (option.subgroup_id () >= 0 ?
-		    subgroups.Get (option.subgroup_id ()).c_str () :
-		    "");
+	    ccsInternString (context, option.subgroup_id () >= 0 ?
+			     subgroups.Get (option.subgroup_id ()).c_str () :
+			     "");
     }
     else
     {
-	setting->shortDesc = strdup (name);
-	setting->longDesc  = strdup ("");
-	setting->hints     = strdup ("");
-	setting->group     = strdup ("");
-	setting->subGroup  = strdup ("");
+	setting->shortDesc = ccsInternString (context, name);
+	setting->longDesc  = ccsInternString (context, "");
+	setting->hints     = ccsInternString (context, "");
+	setting->group     = ccsInternString (context, "");
+	setting->subGroup  = ccsInternString (context, "");
     }
 
     setting->type = (CCSSettingType) option.type ();
@@ -659,9 +720,9 @@ addOptionForPluginPB (CCSPlugin * plugin,
 	}
     }
 
-    PLUGIN_PRIV (plugin);
+    ccsAddSettingToPlugin (plugin, setting);
 
-    pPrivate->settings = ccsSettingListAppend (pPrivate->settings, setting);
+    return setting;
 }
 
 static void
@@ -683,10 +744,14 @@ addOptionFromPB (CCSPlugin * plugin,
 
     if (isScreen)
     {
-	for (unsigned i = 0; i < plugin->context->numScreens; i++)
-	    addOptionForPluginPB (plugin, name, TRUE,
-				  plugin->context->screens[i],
-				  groups, subgroups, option);
+	CCSSetting *setting = NULL;
+
+	if (plugin->context->numScreens)
+	    setting = addOptionForPluginPB (plugin, name, TRUE,
+					    plugin->context->screens[0],
+					    groups, subgroups, option);
+	if (setting)
+	    addSettingForOtherScreens (plugin, setting);
     }
     else
 	addOptionForPluginPB (plugin, name, FALSE, 0, groups, subgroups, option);
@@ -726,7 +791,8 @@ initOptionsFromPB (CCSPlugin * plugin,
 }
 
 static void
-addStringsFromPB (CCSStringList * list,
+addStringsFromPB (CCSContext * context,
+		  CCSStringList * list,
 		  const StringList & strings)
 {
     StringList::const_iterator it;
@@ -736,7 +802,8 @@ addStringsFromPB (CCSStringList * list,
 	const char *value = (*it).c_str ();
 
 	if (strlen (value))
-	    *list = ccsStringListAppend (*list, strdup (value));
+	    *list = ccsStringListAppend (*list,
+					 ccsInternString (context, value));
     }
 }
 
@@ -758,7 +825,7 @@ addStringExtensionFromPB (CCSPlugin * plugin,
 
     extension->basePlugin = strdup (extensionPB.base_plugin ().c_str ());
 
-    addStringsFromPB (&extension->baseSettings,
+    addStringsFromPB (plugin->context, &extension->baseSettings,
 		      extensionPB.base_option ());
 
     int numRestrictions = extensionPB.str_restriction_size ();
@@ -799,22 +866,23 @@ initStringExtensionsFromPB (CCSPlugin * plugin,
 static void
 initRulesFromPB (CCSPlugin * plugin, const PluginInfoMetadata & pluginInfoPB)
 {
-    addStringsFromPB (&plugin->providesFeature, pluginInfoPB.feature ());
+    addStringsFromPB (plugin->context, &plugin->providesFeature, pluginInfoPB.feature ());
 
     if (!pluginInfoPB.has_deps ())
 	return;
 
     const DependenciesMetadata & deps = pluginInfoPB.deps ();
 
-    addStringsFromPB (&plugin->loadAfter, deps.after_plugin ());
-    addStringsFromPB (&plugin->loadBefore, deps.before_plugin ());
-    addStringsFromPB (&plugin->requiresPlugin, deps.require_plugin ());
-    addStringsFromPB (&plugin->requiresFeature, deps.require_feature ());
-    addStringsFromPB (&plugin->conflictPlugin, deps.conflict_plugin ());
-    addStringsFromPB (&plugin->conflictFeature, deps.conflict_feature ());
+    addStringsFromPB (plugin->context, &plugin->loadAfter, deps.after_plugin ());
+    addStringsFromPB (plugin->context, &plugin->loadBefore, deps.before_plugin ());
+    addStringsFromPB (plugin->context, &plugin->requiresPlugin, deps.require_plugin ());
+    addStringsFromPB (plugin->context, &plugin->requiresFeature, deps.require_feature ());
+    addStringsFromPB (plugin->context, &plugin->conflictPlugin, deps.conflict_plugin ());
+    addStringsFromPB (plugin->context, &plugin->conflictFeature, deps.conflict_feature ());
 }
 
-static void
+/* Returns the new plugin, which isn't added to the context yet */
+static CCSPlugin *
 addPluginFromPB (CCSContext * context,
 		 const PluginInfoMetadata & pluginInfoPB,
 		 char *file,
@@ -827,24 +895,21 @@ addPluginFromPB (CCSContext * context,
     name = pluginInfoPB.name ().c_str ();
 
     if (!strlen (name))
-	return;
-
-    if (ccsFindPlugin (context, name))
-	return;
+	return NULL;
 
     if (!strcmp (name, "ini") || !strcmp (name, "gconf") ||
 	!strcmp (name, "ccp") || !strcmp (name, "kconfig"))
-	return;
+	return NULL;
 
     plugin = (CCSPlugin *) calloc (1, sizeof (CCSPlugin));
     if (!plugin)
-	return;
+	return NULL;
 
     pPrivate = (CCSPluginPrivate *) calloc (1, sizeof (CCSPluginPrivate));
     if (!pPrivate)
     {
 	free (plugin);
-	return;
+	return NULL;
     }
     pPrivate->loaded = FALSE;
 
@@ -872,23 +937,25 @@ addPluginFromPB (CCSContext * context,
 	    strdup (pluginInfoPB.has_long_desc () ?
 		    pluginInfoPB.long_desc ().c_str () :
 		    name);
-	plugin->category = strdup (pluginInfoPB.has_category () ?
-				   pluginInfoPB.category ().c_str () :
-				   "");
+	plugin->category =
+	    ccsInternString (context, pluginInfoPB.has_category () ?
+			     pluginInfoPB.category ().c_str () :
+			     "");
     }
     else
     {
 	plugin->shortDesc = strdup (name);
 	plugin->longDesc  = strdup (name);
-	plugin->category  = strdup ("");
+	plugin->category  = ccsInternString (context, "");
     }
 
     initRulesFromPB (plugin, pluginInfoPB);
 
-    context->plugins = ccsPluginListAppend (context->plugins, plugin);
+    return plugin;
 }
 
-static void
+/* Returns the core plugin, which isn't added to the context yet */
+static CCSPlugin *
 addCoreSettingsFromPB (CCSContext * context,
 		       const PluginInfoMetadata & pluginInfoPB,
 		       char *file,
@@ -897,18 +964,15 @@ addCoreSettingsFromPB (CCSContext * context,
     CCSPlugin *plugin;
     CCSPluginPrivate *pPrivate;
 
-    if (ccsFindPlugin (context, "core"))
-	return;
-
     plugin = (CCSPlugin*) calloc (1, sizeof (CCSPlugin));
     if (!plugin)
-	return;
+	return NULL;
 
     pPrivate = (CCSPluginPrivate *) calloc (1, sizeof (CCSPluginPrivate));
     if (!pPrivate)
     {
 	free (plugin);
-	return;
+	return NULL;
     }
 
     plugin->ccsPrivate = (void *) pPrivate;
@@ -924,7 +988,7 @@ addCoreSettingsFromPB (CCSContext * context,
 
     plugin->context = context;
     plugin->name = strdup ("core");
-    plugin->category = strdup ("General");
+    plugin->category = ccsInternString (context, "General");
 
     if (!basicMetadata)
     {
@@ -945,7 +1009,8 @@ addCoreSettingsFromPB (CCSContext * context,
     }
 
     initRulesFromPB (plugin, pluginInfoPB);
-    context->plugins = ccsPluginListAppend (context->plugins, plugin);
+
+    return plugin;
 }
 
 #endif
@@ -1011,41 +1076,6 @@ getOptionType (const char *name)
     return TypeNum;
 }
 
-static char *
-getStringFromXPath (xmlDoc * doc, xmlNode * base, const char *path)
-{
-    xmlXPathObjectPtr xpathObj;
-    xmlXPathContextPtr xpathCtx;
-    char *rv = NULL;
-
-    xpathCtx = xmlXPathNewContext (doc);
-    if (!xpathCtx)
-	return NULL;
-
-    if (base)
-	xpathCtx->node = base;
-
-    xpathObj = xmlXPathEvalExpression (BAD_CAST path, xpathCtx);
-
-    if (!xpathObj)
-    {
-	xmlXPathFreeContext (xpathCtx);
-	return NULL;
-    }
-
-    xpathObj = xmlXPathConvertString (xpathObj);
-
-    if (xpathObj->type == XPATH_STRING && xpathObj->stringval
-	&& strlen ((char *) xpathObj->stringval))
-    {
-	rv = strdup ((char *) xpathObj->stringval);
-    }
-
-    xmlXPathFreeObject (xpathObj);
-    xmlXPathFreeContext (xpathCtx);
-    return rv;
-}
-
 static xmlNode **
 getNodesFromXPath (xmlDoc * doc, xmlNode * base, const char *path, int *num)
 {
@@ -1097,72 +1127,171 @@ getNodesFromXPath (xmlDoc * doc, xmlNode * base, const char *path, int *num)
     return rv;
 }
 
-static Bool
-nodeExists (xmlNode * node, const char *path)
+/* Returns the first element from node on (node included) called name */
+static xmlNode *
+findNode (xmlNode * node, const char *name)
 {
-    xmlNode **nodes = NULL;
-    int num;
-    nodes = getNodesFromXPath (node->doc, node, path, &num);
+    for (; node; node = node->next)
+	if (node->type == XML_ELEMENT_NODE &&
+	    !strcmp ((const char *) node->name, name))
+	    return node;
 
-    if (num)
+    return NULL;
+}
+
+/* Returns the first element child of node called name */
+static inline xmlNode *
+getChildNode (xmlNode * node, const char *name)
+{
+    return findNode (node->children, name);
+}
+
+/* Returns the next sibling of child called name */
+static inline xmlNode *
+getNextChildNode (xmlNode * child, const char *name)
+{
+    return findNode (child->next, name);
+}
+
+/* Returns the first text of node, like "child::text()", or NULL */
+static const char *
+getNodeTextPtr (xmlNode * node)
+{
+    xmlNode *child;
+
+    for (child = node->children; child; child = child->next)
+	if (child->type == XML_TEXT_NODE ||
+	    child->type == XML_CDATA_SECTION_NODE)
+	    return (child->content && *child->content) ?
+		(const char *) child->content : NULL;
+
+    return NULL;
+}
+
+/* Same as getNodeTextPtr, but returns a copy */
+static char *
+getNodeText (xmlNode * node)
+{
+    const char *text = getNodeTextPtr (node);
+
+    return text ? strdup (text) : NULL;
+}
+
+/* Returns a copy of the first text of the name children of node, like
+   "name/child::text()", or NULL */
+static char *
+getChildText (xmlNode * node, const char *name)
+{
+    xmlNode *child;
+
+    for (child = getChildNode (node, name); child;
+	 child = getNextChildNode (child, name))
     {
-	free (nodes);
-	return TRUE;
+	const char *text = getNodeTextPtr (child);
+
+	if (text)
+	    return strdup (text);
     }
 
-    return FALSE;
+    return NULL;
 }
 
+/* Returns a copy of the attribute name of node or NULL if it is empty */
 static char *
-stringFromNodeDef (xmlNode * node, const char *path, const char *def)
+getAttribute (xmlNode * node, const char *name)
 {
-    char *val;
+    xmlChar *value = xmlGetProp (node, BAD_CAST name);
     char *rv = NULL;
 
-    val = getStringFromXPath (node->doc, node, path);
-
-    if (val)
+    if (value)
     {
-	rv = strdup (val);
-	free (val);
+	if (*value)
+	    rv = strdup ((char *) value);
+	xmlFree (value);
     }
-    else if (def)
+
+    return rv;
+}
+
+static char *
+stringFromChildDef (xmlNode * node, const char *name, const char *def)
+{
+    char *rv = getChildText (node, name);
+
+    if (!rv && def)
 	rv = strdup (def);
 
     return rv;
 }
 
+/* The XPath lang () test: the language of a node matches lang if they are
+   equal or lang is followed by a '-' in it */
+static Bool
+nodeLangMatches (const char *nodeLang, const char *lang, size_t len)
+{
+    return (!strncasecmp (nodeLang, lang, len) &&
+	    (nodeLang[len] == '\0' || nodeLang[len] == '-'));
+}
+
+/* Picks the text of the name child of node that best matches the locale,
+   in a single pass over the children. Same order as the former XPath
+   lookups: the full locale, the locale without encoding, the language
+   alone, "C" and then any child. */
 static char *
-stringFromNodeDefTrans (xmlNode * node, const char *path, const char *def)
+stringFromChildDefTrans (xmlNode * node, const char *name, const char *def)
 {
     const char *lang = getLocale ();
-    char newPath[1024];
-    char *rv = NULL;
+    const char *langs[4];
+    size_t lens[4];
+    const char *best = NULL, *any = NULL;
+    int bestRank = 4, rank;
+    xmlNode *child;
 
     if (!lang || !strlen (lang))
-	return stringFromNodeDef (node, path, def);
+	return stringFromChildDef (node, name, def);
+
+    /* substring-before () is empty if the separator is missing */
+    langs[0] = langs[1] = langs[2] = lang;
+    lens[0] = strlen (lang);
+    lens[1] = strchr (lang, '.') ? strchr (lang, '.') - lang : 0;
+    lens[2] = strchr (lang, '_') ? strchr (lang, '_') - lang : 0;
+    langs[3] = "C";
+    lens[3] = 1;
+
+    for (child = getChildNode (node, name); child && bestRank;
+	 child = getNextChildNode (child, name))
+    {
+	const char *text = getNodeTextPtr (child);
+	xmlChar *nodeLang;
+
+	if (!text)
+	    continue;
+	if (!any)
+	    any = text;
 
-    snprintf (newPath, 1023, "%s[lang('%s')]", path, lang);
-    rv = stringFromNodeDef (node, newPath, NULL);
-    if (rv)
-	return rv;
+	nodeLang = xmlNodeGetLang (child);
+	if (!nodeLang)
+	    continue;
+
+	for (rank = 0; rank < bestRank; rank++)
+	    if (nodeLangMatches ((const char *) nodeLang, langs[rank],
+				 lens[rank]))
+	    {
+		best = text;
+		bestRank = rank;
+		break;
+	    }
 
-    snprintf (newPath, 1023, "%s[lang(substring-before('%s','.'))]", path, lang);
-    rv = stringFromNodeDef (node, newPath, NULL);
-    if (rv)
-	return rv;
+	xmlFree (nodeLang);
+    }
 
-    snprintf (newPath, 1023, "%s[lang(substring-before('%s','_'))]", path, lang);
-    rv = stringFromNodeDef (node, newPath, NULL);
-    if (rv)
-	return rv;
+    if (!best)
+	best = any;
 
-    snprintf (newPath, 1023, "%s[lang('C')]", path);
-    rv = stringFromNodeDef (node, newPath, NULL);
-    if (rv)
-	return rv;
+    if (best)
+	return strdup (best);
 
-    return stringFromNodeDef (node, path, def);
+    return def ? strdup (def) : NULL;
 }
 
 static void
@@ -1174,7 +1303,7 @@ initBoolValue (CCSSettingValue * v,
 
     v->value.asBool = FALSE;
 
-    value = getStringFromXPath (node->doc, node, "child::text()");
+    value = getNodeText (node);
 
     if (value)
     {
@@ -1200,7 +1329,7 @@ initIntValue (CCSSettingValue * v,
 
     v->value.asInt = (i->forInt.min + i->forInt.max) / 2;
 
-    value = getStringFromXPath (node->doc, node, "child::text()");
+    value = getNodeText (node);
 
     if (value)
     {
@@ -1232,7 +1361,7 @@ initFloatValue (CCSSettingValue * v,
 
     loc = setlocale (LC_NUMERIC, NULL);
     setlocale (LC_NUMERIC, "C");
-    value = getStringFromXPath (node->doc, node, "child::text()");
+    value = getNodeText (node);
 
     if (value)
     {
@@ -1261,7 +1390,7 @@ initStringValue (CCSSettingValue * v,
 {
     char *value;
 
-    value = getStringFromXPath (node->doc, node, "child::text()");
+    value = getNodeText (node);
 
     if (value)
     {
@@ -1292,7 +1421,7 @@ initColorValue (CCSSettingValue * v, xmlNode * node, void * valuePBv)
 	colorPB = ((GenericValueMetadata *) valuePBv)->mutable_color_value ();
 #endif
 
-    value = getStringFromXPath (node->doc, node, "red/child::text()");
+    value = getChildText (node, "red");
     if (value)
     {
 	int color = strtol ((char *) value, NULL, 0);
@@ -1305,7 +1434,7 @@ initColorValue (CCSSettingValue * v, xmlNode * node, void * valuePBv)
 	free (value);
     }
 
-    value = getStringFromXPath (node->doc, node, "green/child::text()");
+    value = getChildText (node, "green");
     if (value)
     {
 	int color = strtol ((char *) value, NULL, 0);
@@ -1318,7 +1447,7 @@ initColorValue (CCSSettingValue * v, xmlNode * node, void * valuePBv)
 	free (value);
     }
 
-    value = getStringFromXPath (node->doc, node, "blue/child::text()");
+    value = getChildText (node, "blue");
     if (value)
     {
 	int color = strtol ((char *) value, NULL, 0);
@@ -1331,7 +1460,7 @@ initColorValue (CCSSettingValue * v, xmlNode * node, void * valuePBv)
 	free (value);
     }
 
-    value = getStringFromXPath (node->doc, node, "alpha/child::text()");
+    value = getChildText (node, "alpha");
     if (value)
     {
 	int color = strtol (value, NULL, 0);
@@ -1350,7 +1479,7 @@ initMatchValue (CCSSettingValue * v, xmlNode * node, void * valuePBv)
 {
     char *value;
 
-    value = getStringFromXPath (node->doc, node, "child::text()");
+    value = getNodeText (node);
     if (value)
     {
 	free (v->value.asMatch);
@@ -1376,7 +1505,7 @@ initKeyValue (CCSSettingValue * v,
 
     memset (&v->value.asKey, 0, sizeof (v->value.asKey));
 
-    value = getStringFromXPath (node->doc, node, "child::text()");
+    value = getNodeText (node);
     if (value)
     {
 #ifdef USE_PROTOBUF
@@ -1401,7 +1530,7 @@ initButtonValue (CCSSettingValue * v,
 
     memset (&v->value.asButton, 0, sizeof (v->value.asButton));
 
-    value = getStringFromXPath (node->doc, node, "child::text()");
+    value = getNodeText (node);
     if (value)
     {
 #ifdef USE_PROTOBUF
@@ -1422,9 +1551,8 @@ initEdgeValue (CCSSettingValue * v,
 	       xmlNode * node,
 	       void * valuePBv)
 {
-    xmlNode **nodes;
+    xmlNode *child;
     char *value;
-    int k, num;
 
     v->value.asEdge = 0;
 
@@ -1439,11 +1567,10 @@ initEdgeValue (CCSSettingValue * v,
 	"BottomRight"
     };
 
-    nodes = getNodesFromXPath (node->doc, node, "edge", &num);
-
-    for (k = 0; k < num; k++)
+    for (child = getChildNode (node, "edge"); child;
+	 child = getNextChildNode (child, "edge"))
     {
-	value = getStringFromXPath (node->doc, nodes[k], "@name");
+	value = getAttribute (child, "name");
 	if (value)
 	{
 	    for (unsigned j = 0; j < sizeof (edge) / sizeof (edge[0]); j++)
@@ -1454,8 +1581,6 @@ initEdgeValue (CCSSettingValue * v,
 	    free (value);
 	}
     }
-    if (num)
-	free (nodes);
 
 #ifdef USE_PROTOBUF
     if (valuePBv)
@@ -1473,7 +1598,7 @@ initBellValue (CCSSettingValue * v,
 
     v->value.asBell = FALSE;
 
-    value = getStringFromXPath (node->doc, node, "child::text()");
+    value = getNodeText (node);
     if (value)
     {
 	if (!strcasecmp (value, "true"))
@@ -1494,79 +1619,77 @@ initListValue (CCSSettingValue * v,
 	       xmlNode * node,
 	       void * optionPBv)
 {
-    xmlNode **nodes;
-    int num, j;
+    CCSSettingValueSeq values = { NULL, NULL, 0 };
+    xmlNode *child;
 
-    nodes = getNodesFromXPath (node->doc, node, "value", &num);
-    if (num)
+    for (child = getChildNode (node, "value"); child;
+	 child = getNextChildNode (child, "value"))
     {
-	for (j = 0; j < num; j++)
-	{
-	    void *valuePBv = NULL;
+	void *valuePBv = NULL;
 #ifdef USE_PROTOBUF
-	    if (optionPBv)
-		valuePBv = ((OptionMetadata *) optionPBv)->add_default_value ();
+	if (optionPBv)
+	    valuePBv = ((OptionMetadata *) optionPBv)->add_default_value ();
 #endif
-	    CCSSettingValue *val;
-	    val = (CCSSettingValue *) calloc (1, sizeof (CCSSettingValue));
-	    if (!val)
-		continue;
+	CCSSettingValue *val;
+	val = (CCSSettingValue *) calloc (1, sizeof (CCSSettingValue));
+	if (!val)
+	    continue;
 
-	    val->parent = v->parent;
-	    val->isListChild = TRUE;
+	val->parent = v->parent;
+	val->isListChild = TRUE;
 
-	    switch (i->forList.listType)
-	    {
-	    case TypeBool:
-		initBoolValue (val, nodes[j], valuePBv);
-		break;
-	    case TypeInt:
-		initIntValue (val, i->forList.listInfo, nodes[j], valuePBv);
-		break;
-	    case TypeFloat:
-		initFloatValue (val, i->forList.listInfo, nodes[j], valuePBv);
-		break;
-	    case TypeString:
-		initStringValue (val, i->forList.listInfo, nodes[j], valuePBv);
-		break;
-	    case TypeColor:
-		initColorValue (val, nodes[j], valuePBv);
-		break;
-	    case TypeKey:
-		initKeyValue (val, i->forList.listInfo, nodes[j], valuePBv);
-		break;
-	    case TypeButton:
-		initButtonValue (val, i->forList.listInfo, nodes[j], valuePBv);
-		break;
-	    case TypeEdge:
-		initEdgeValue (val, i->forList.listInfo, nodes[j], valuePBv);
-		break;
-	    case TypeBell:
-		initBellValue (val, i->forList.listInfo, nodes[j], valuePBv);
-		break;
-	    case TypeMatch:
-		initMatchValue (val, nodes[j], valuePBv);
-	    default:
-		break;
-	    }
-	    v->value.asList = ccsSettingValueListAppend (v->value.asList, val);
+	switch (i->forList.listType)
+	{
+	case TypeBool:
+	    initBoolValue (val, child, valuePBv);
+	    break;
+	case TypeInt:
+	    initIntValue (val, i->forList.listInfo, child, valuePBv);
+	    break;
+	case TypeFloat:
+	    initFloatValue (val, i->forList.listInfo, child, valuePBv);
+	    break;
+	case TypeString:
+	    initStringValue (val, i->forList.listInfo, child, valuePBv);
+	    break;
+	case TypeColor:
+	    initColorValue (val, child, valuePBv);
+	    break;
+	case TypeKey:
+	    initKeyValue (val, i->forList.listInfo, child, valuePBv);
+	    break;
+	case TypeButton:
+	    initButtonValue (val, i->forList.listInfo, child, valuePBv);
+	    break;
+	case TypeEdge:
+	    initEdgeValue (val, i->forList.listInfo, child, valuePBv);
+	    break;
+	case TypeBell:
+	    initBellValue (val, i->forList.listInfo, child, valuePBv);
+	    break;
+	case TypeMatch:
+	    initMatchValue (val, child, valuePBv);
+	default:
+	    break;
 	}
-	free (nodes);
+	ccsSettingValueSeqAppend (&values, val);
     }
+
+    if (values.head)
+	v->value.asList = values.head;
 }
 
 static void
 initIntInfo (CCSSettingInfo * i, xmlNode * node, void * optionPBv)
 {
-    xmlNode **nodes;
+    xmlNode *child;
     char *name;
     char *value;
-    int num, j;
     i->forInt.min = MINSHORT;
     i->forInt.max = MAXSHORT;
     i->forInt.desc = NULL;
 
-    value = getStringFromXPath (node->doc, node, "min/child::text()");
+    value = getChildText (node, "min");
     if (value)
     {
 	int val = strtol (value, NULL, 0);
@@ -1578,7 +1701,7 @@ initIntInfo (CCSSettingInfo * i, xmlNode * node, void * optionPBv)
 #endif
     }
 
-    value = getStringFromXPath (node->doc, node, "max/child::text()");
+    value = getChildText (node, "max");
     if (value)
     {
 	int val = strtol (value, NULL, 0);
@@ -1592,52 +1715,45 @@ initIntInfo (CCSSettingInfo * i, xmlNode * node, void * optionPBv)
 
     if (!basicMetadata)
     {
-	nodes = getNodesFromXPath (node->doc, node, "desc", &num);
-	if (num)
+	for (child = getChildNode (node, "desc"); child;
+	     child = getNextChildNode (child, "desc"))
 	{
-	    for (j = 0; j < num; j++)
+	    value = getChildText (child, "value");
+	    if (value)
 	    {
-		value = getStringFromXPath (node->doc, nodes[j],
-					    "value/child::text()");
-		if (value)
-		{
-		    int val = strtol (value, NULL, 0);
-		    free (value);
+		int val = strtol (value, NULL, 0);
+		free (value);
 
-		    if (val >= i->forInt.min && val <= i->forInt.max)
+		if (val >= i->forInt.min && val <= i->forInt.max)
+		{
+		    name = stringFromChildDefTrans (child, "name", NULL);
+		    if (name)
 		    {
-			name = stringFromNodeDefTrans (nodes[j],
-						       "name/child::text()",
-						       NULL);
-			if (name)
-			{
-			    CCSIntDesc *intDesc;
+			CCSIntDesc *intDesc;
 
-			    intDesc = (CCSIntDesc *) calloc (1, sizeof (CCSIntDesc));
-			    if (intDesc)
+			intDesc = (CCSIntDesc *) calloc (1, sizeof (CCSIntDesc));
+			if (intDesc)
+			{
+			    intDesc->name = strdup (name);
+			    intDesc->value = val;
+			    i->forInt.desc =
+				ccsIntDescListAppend (i->forInt.desc,
+						      intDesc);
+#ifdef USE_PROTOBUF
+			    if (optionPBv)
 			    {
-				intDesc->name = strdup (name);
-				intDesc->value = val;
-				i->forInt.desc =
-				    ccsIntDescListAppend (i->forInt.desc,
-							  intDesc);
-#ifdef USE_PROTOBUF
-				if (optionPBv)
-				{
-				    OptionMetadata::IntDescription *intDescPB =
-					((OptionMetadata *) optionPBv)->
-					add_int_desc ();
-				    intDescPB->set_value (val);
-				    intDescPB->set_name (name);
-				}
-#endif
+				OptionMetadata::IntDescription *intDescPB =
+				    ((OptionMetadata *) optionPBv)->
+				    add_int_desc ();
+				intDescPB->set_value (val);
+				intDescPB->set_name (name);
 			    }
-			    free (name);
+#endif
 			}
+			free (name);
 		    }
 		}
 	    }
-	    free (nodes);
 	}
     }
 }
@@ -1654,7 +1770,7 @@ initFloatInfo (CCSSettingInfo * i, xmlNode * node, void * optionPBv)
 
     loc = setlocale (LC_NUMERIC, NULL);
     setlocale (LC_NUMERIC, "C");
-    value = getStringFromXPath (node->doc, node, "min/child::text()");
+    value = getChildText (node, "min");
     if (value)
     {
 	float val = strtod (value, NULL);
@@ -1666,7 +1782,7 @@ initFloatInfo (CCSSettingInfo * i, xmlNode * node, void * optionPBv)
 #endif
     }
 
-    value = getStringFromXPath (node->doc, node, "max/child::text()");
+    value = getChildText (node, "max");
     if (value)
     {
 	float val = strtod (value, NULL);
@@ -1678,7 +1794,7 @@ initFloatInfo (CCSSettingInfo * i, xmlNode * node, void * optionPBv)
 #endif
     }
 
-    value = getStringFromXPath (node->doc, node, "precision/child::text()");
+    value = getChildText (node, "precision");
     if (value)
     {
 	float val = strtod (value, NULL);
@@ -1696,17 +1812,16 @@ initFloatInfo (CCSSettingInfo * i, xmlNode * node, void * optionPBv)
 static void
 initStringInfo (CCSSettingInfo * i, xmlNode * node, void * optionPBv)
 {
-    xmlNode **nodes;
+    xmlNode *child;
     char *name;
     char *value;
-    int num, j;
     i->forString.restriction = NULL;
     i->forString.sortStartsAt = -1;
     i->forString.extensible = FALSE;
 
     if (!basicMetadata)
     {
-	if (nodeExists (node, "extensible"))
+	if (getChildNode (node, "extensible"))
 	{
 	    i->forString.extensible = TRUE;
 #ifdef USE_PROTOBUF
@@ -1715,12 +1830,12 @@ initStringInfo (CCSSettingInfo * i, xmlNode * node, void * optionPBv)
 #endif
 	}
 
-	nodes = getNodesFromXPath (node->doc, node, "sort", &num);
-	if (num)
+	child = getChildNode (node, "sort");
+	if (child)
 	{
 	    int val = 0; /* Start sorting at 0 unless otherwise specified. */
 
-	    value = getStringFromXPath (node->doc, nodes[0], "@start");
+	    value = getAttribute (child, "start");
 	    if (value)
 	    {
 		/* Custom starting value specified. */
@@ -1734,44 +1849,36 @@ initStringInfo (CCSSettingInfo * i, xmlNode * node, void * optionPBv)
 	    if (optionPBv)
 		((OptionMetadata *) optionPBv)->set_sort_start (val);
 #endif
-	    free (nodes);
 	}
 
-	nodes = getNodesFromXPath (node->doc, node, "restriction", &num);
-	if (num)
+	for (child = getChildNode (node, "restriction"); child;
+	     child = getNextChildNode (child, "restriction"))
 	{
-	    for (j = 0; j < num; j++)
-	    {
 #ifdef USE_PROTOBUF
-		OptionMetadata::StringRestriction * strRestrictionPB = NULL;
-		if (optionPBv)
-		    strRestrictionPB =
-			((OptionMetadata *) optionPBv)->add_str_restriction ();
+	    OptionMetadata::StringRestriction * strRestrictionPB = NULL;
+	    if (optionPBv)
+		strRestrictionPB =
+		    ((OptionMetadata *) optionPBv)->add_str_restriction ();
 #endif
-		value = getStringFromXPath (node->doc, nodes[j],
-					   "value/child::text()");
-		if (value)
+	    value = getChildText (child, "value");
+	    if (value)
+	    {
+		name = stringFromChildDefTrans (child, "name", NULL);
+		if (name)
 		{
-		    name = stringFromNodeDefTrans (nodes[j],
-						   "name/child::text()",
-						   NULL);
-		    if (name)
-		    {
-			ccsAddRestrictionToStringInfo (&i->forString,
-						       name, value);
+		    ccsAddRestrictionToStringInfo (&i->forString,
+						   name, value);
 #ifdef USE_PROTOBUF
-			if (strRestrictionPB)
-			{
-			    strRestrictionPB->set_value (value);
-			    strRestrictionPB->set_name (name);
-			}
-#endif
-			free (name);
+		    if (strRestrictionPB)
+		    {
+			strRestrictionPB->set_value (value);
+			strRestrictionPB->set_name (name);
 		    }
-		    free (value);
+#endif
+		    free (name);
 		}
+		free (value);
 	    }
-	    free (nodes);
 	}
     }
 }
@@ -1785,7 +1892,7 @@ initListInfo (CCSSettingInfo * i, xmlNode * node, void * optionPBv)
     i->forList.listType = TypeBool;
     i->forList.listInfo = NULL;
 
-    value = getStringFromXPath (node->doc, node, "type/child::text()");
+    value = getChildText (node, "type");
 
     if (!value)
 	return;
@@ -1837,7 +1944,7 @@ initActionInfo (CCSSettingInfo * i, xmlNode * node, void * optionPBv)
 
     i->forAction.internal = FALSE;
 
-    value = getStringFromXPath (node->doc, node, "internal/child::text()");
+    value = getChildText (node, "internal");
     if (value)
     {
 	if (strcasecmp (value, "true") == 0)
@@ -1851,7 +1958,7 @@ initActionInfo (CCSSettingInfo * i, xmlNode * node, void * optionPBv)
 	free (value);
 	return;
     }
-    if (nodeExists (node, "internal"))
+    if (getChildNode (node, "internal"))
     {
 	i->forAction.internal = TRUE;
 #ifdef USE_PROTOBUF
@@ -1942,7 +2049,7 @@ createProtoBufCacheDir ()
 
 #endif
 
-static void
+static CCSSetting *
 addOptionForPlugin (CCSPlugin * plugin,
 		    char * name,
 		    char * type,
@@ -1950,26 +2057,38 @@ addOptionForPlugin (CCSPlugin * plugin,
 		    Bool isScreen,
 		    unsigned int screen,
 		    xmlNode * node,
+		    const char * group,
+		    const char * subGroup,
 		    void * groupListPBv,
 		    void * subgroupListPBv,
 		    void * optionPBv)
 {
-    xmlNode **nodes;
-    int num = 0;
+    xmlNode *defNode;
+    CCSContext *context = plugin->context;
     CCSSetting *setting;
+    CCSSettingPrivate *sPrivate;
 
     if (ccsFindSetting (plugin, name, isScreen, screen))
     {
 	fprintf (stderr, "[ERROR]: Option \"%s\" already defined\n", name);
-	return;
+	return NULL;
     }
 
     if (getOptionType (type) == TypeNum)
-	return;
+	return NULL;
 
     setting = (CCSSetting *) calloc (1, sizeof (CCSSetting));
     if (!setting)
-	return;
+	return NULL;
+
+    sPrivate = (CCSSettingPrivate *) calloc (1, sizeof (CCSSettingPrivate));
+    if (!sPrivate)
+    {
+	free (setting);
+	return NULL;
+    }
+
+    setting->ccsPrivate = (void *) sPrivate;
 
     setting->parent = plugin;
     setting->isScreen = isScreen;
@@ -1979,26 +2098,38 @@ addOptionForPlugin (CCSPlugin * plugin,
 
     if (!basicMetadata)
     {
-	setting->shortDesc =
-	    stringFromNodeDefTrans (node, "short/child::text()", name);
-	setting->longDesc =
-	    stringFromNodeDefTrans (node, "long/child::text()", "");
-	setting->hints = stringFromNodeDef (node, "hints/child::text()", "");
-	setting->group =
-	    stringFromNodeDefTrans (node, "ancestor::group/short/child::text()",
-				    "");
-	setting->subGroup =
-	    stringFromNodeDefTrans (node,
-				    "ancestor::subgroup/short/child::text()",
-				    "");
+	/* the descriptions still go into a .pb that is being written */
+	if (lazyDescriptions && !optionPBv)
+	{
+	    setting->shortDesc = ccsInternString (context, name);
+	    setting->longDesc  = ccsInternString (context, "");
+	    ((CCSPluginPrivate *) plugin->ccsPrivate)->descriptionsPending =
+		TRUE;
+	}
+	else
+	{
+	    setting->shortDesc =
+		ccsInternOwnedString (context,
+				      stringFromChildDefTrans (node, "short",
+							       name));
+	    setting->longDesc =
+		ccsInternOwnedString (context,
+				      stringFromChildDefTrans (node, "long",
+							       ""));
+	}
+	setting->hints =
+	    ccsInternOwnedString (context,
+				  stringFromChildDef (node, "hints", ""));
+	setting->group = ccsInternString (context, group);
+	setting->subGroup = ccsInternString (context, subGroup);
     }
     else
     {
-	setting->shortDesc = strdup (name);
-	setting->longDesc  = strdup ("");
-	setting->hints     = strdup ("");
-	setting->group     = strdup ("");
-	setting->subGroup  = strdup ("");
+	setting->shortDesc = ccsInternString (context, name);
+	setting->longDesc  = ccsInternString (context, "");
+	setting->hints     = ccsInternString (context, "");
+	setting->group     = ccsInternString (context, "");
+	setting->subGroup  = ccsInternString (context, "");
     }
     setting->type = getOptionType (type);
 
@@ -2055,8 +2186,8 @@ addOptionForPlugin (CCSPlugin * plugin,
 	break;
     }
 
-    nodes = getNodesFromXPath (node->doc, node, "default", &num);
-    if (num)
+    defNode = getChildNode (node, "default");
+    if (defNode)
     {
 	void * valuePBv = NULL;
 #ifdef USE_PROTOBUF
@@ -2066,46 +2197,46 @@ addOptionForPlugin (CCSPlugin * plugin,
 	switch (setting->type)
 	{
 	case TypeInt:
-	    initIntValue (&setting->defaultValue, &setting->info, nodes[0],
+	    initIntValue (&setting->defaultValue, &setting->info, defNode,
 			  valuePBv);
 	    break;
 	case TypeBool:
-	    initBoolValue (&setting->defaultValue, nodes[0],
+	    initBoolValue (&setting->defaultValue, defNode,
 			   valuePBv);
 	    break;
 	case TypeFloat:
-	    initFloatValue (&setting->defaultValue, &setting->info, nodes[0],
+	    initFloatValue (&setting->defaultValue, &setting->info, defNode,
 			    valuePBv);
 	    break;
 	case TypeString:
-	    initStringValue (&setting->defaultValue, &setting->info, nodes[0],
+	    initStringValue (&setting->defaultValue, &setting->info, defNode,
 			     valuePBv);
 	    break;
 	case TypeColor:
-	    initColorValue (&setting->defaultValue, nodes[0], valuePBv);
+	    initColorValue (&setting->defaultValue, defNode, valuePBv);
 	    break;
 	case TypeKey:
-	    initKeyValue (&setting->defaultValue, &setting->info, nodes[0],
+	    initKeyValue (&setting->defaultValue, &setting->info, defNode,
 			  valuePBv);
 	    break;
 	case TypeButton:
-	    initButtonValue (&setting->defaultValue, &setting->info, nodes[0],
+	    initButtonValue (&setting->defaultValue, &setting->info, defNode,
 			     valuePBv);
 	    break;
 	case TypeEdge:
-	    initEdgeValue (&setting->defaultValue, &setting->info, nodes[0],
+	    initEdgeValue (&setting->defaultValue, &setting->info, defNode,
 			   valuePBv);
 	    break;
 	case TypeBell:
-	    initBellValue (&setting->defaultValue, &setting->info, nodes[0],
+	    initBellValue (&setting->defaultValue, &setting->info, defNode,
 			   valuePBv);
 	    break;
 	case TypeMatch:
-	    initMatchValue (&setting->defaultValue, nodes[0],
+	    initMatchValue (&setting->defaultValue, defNode,
 			    valuePBv);
 	    break;
 	case TypeList:
-	    initListValue (&setting->defaultValue, &setting->info, nodes[0],
+	    initListValue (&setting->defaultValue, &setting->info, defNode,
 			   optionPBv);
 	    break;
 	default:
@@ -2129,24 +2260,24 @@ addOptionForPlugin (CCSPlugin * plugin,
 	}
     }
 
-    if (nodes)
-	free (nodes);
-
     if (isReadonly)
     {
 	// Will come here only when protobuf is enabled
 	ccsFreeSetting (setting);
-	return;
+	return NULL;
     }
     //	printSetting (setting);
-    PLUGIN_PRIV (plugin);
-    pPrivate->settings = ccsSettingListAppend (pPrivate->settings, setting);
+    ccsAddSettingToPlugin (plugin, setting);
+
+    return setting;
 }
 
 static void
 addOptionFromXMLNode (CCSPlugin * plugin,
 		      xmlNode * node,
 		      Bool isScreen,
+		      const char * group,
+		      const char * subGroup,
 		      void * groupListPBv,
 		      void * subgroupListPBv,
 		      void * optionPBv)
@@ -2159,11 +2290,11 @@ addOptionFromXMLNode (CCSPlugin * plugin,
     if (!node)
 	return;
 
-    name = getStringFromXPath (node->doc, node, "@name");
+    name = getAttribute (node, "name");
 
-    type = getStringFromXPath (node->doc, node, "@type");
+    type = getAttribute (node, "type");
 
-    readonly = getStringFromXPath (node->doc, node, "@read_only");
+    readonly = getAttribute (node, "read_only");
     isReadonly = readonly && !strcmp (readonly, "true");
 
     // If optionPBv is non-NULL, we still want to get the option info to write
@@ -2184,14 +2315,22 @@ addOptionFromXMLNode (CCSPlugin * plugin,
 
     if (isScreen)
     {
-	for (unsigned i = 0; i < plugin->context->numScreens; i++)
-	    addOptionForPlugin (plugin, name, type, isReadonly, TRUE,
-				plugin->context->screens[i], node,
-				groupListPBv, subgroupListPBv, optionPBv);
+	CCSSetting *setting = NULL;
+
+	/* read only options are only parsed to be written to the .pb
+	   file, once is enough */
+	if (plugin->context->numScreens)
+	    setting = addOptionForPlugin (plugin, name, type, isReadonly, TRUE,
+					  plugin->context->screens[0], node,
+					  group, subGroup, groupListPBv,
+					  subgroupListPBv, optionPBv);
+	if (setting)
+	    addSettingForOtherScreens (plugin, setting);
     }
     else
     {
 	addOptionForPlugin (plugin, name, type, isReadonly, FALSE, 0, node,
+			    group, subGroup,
 			    groupListPBv, subgroupListPBv, optionPBv);
     }
     free (name);
@@ -2201,56 +2340,97 @@ addOptionFromXMLNode (CCSPlugin * plugin,
 	free (readonly);
 }
 
+/* Adds the options below node in document order, the same set as
+   "option | group/subgroup/option | group/option | subgroup/option".
+   group and subGroup are NULL until the walk enters one of them. */
 static void
-initDisplayScreenFromRootNode (CCSPlugin * plugin,
-			       xmlNode * node,
-			       Bool isScreen,
-			       void * pluginPBv)
+addOptionsFromXMLNode (CCSPlugin * plugin,
+		       xmlNode * node,
+		       Bool isScreen,
+		       const char * group,
+		       const char * subGroup,
+		       void * screenPBv)
 {
-    xmlNode **nodes;
-    xmlNode **optNodes;
-    int num, i;
+    xmlNode *child;
     void *groupListPBv = NULL;
     void *subgroupListPBv = NULL;
 
-    nodes = getNodesFromXPath (node->doc, node,
-			       (isScreen ? "screen" : "display"), &num);
-    if (!num)
-	return;
-
 #ifdef USE_PROTOBUF
-    ScreenMetadata *screenPB = NULL;
-
-    if (pluginPBv)
+    if (screenPBv)
     {
-	PluginMetadata *pluginPB = (PluginMetadata *) pluginPBv;
-	screenPB = (isScreen ?
-		    pluginPB->mutable_screen () :
-		    pluginPB->mutable_display ());
-	groupListPBv = screenPB->mutable_group_desc ();
-	subgroupListPBv = screenPB->mutable_subgroup_desc ();
+	groupListPBv = ((ScreenMetadata *) screenPBv)->mutable_group_desc ();
+	subgroupListPBv =
+	    ((ScreenMetadata *) screenPBv)->mutable_subgroup_desc ();
     }
 #endif
-    optNodes = getNodesFromXPath
-	(node->doc, nodes[0],
-	 "option | group/subgroup/option | group/option | subgroup/option",
-	 &num);
-    if (num)
+
+    for (child = node->children; child; child = child->next)
     {
-	for (i = 0; i < num; i++)
+	const char *childName = (const char *) child->name;
+
+	if (child->type != XML_ELEMENT_NODE)
+	    continue;
+
+	if (!strcmp (childName, "option"))
 	{
 	    void *optionPBv = NULL;
-    #ifdef USE_PROTOBUF
-	    if (screenPB)
-		optionPBv = screenPB->add_option ();
-    #endif
-	    addOptionFromXMLNode (plugin, optNodes[i], isScreen,
+#ifdef USE_PROTOBUF
+	    if (screenPBv)
+		optionPBv = ((ScreenMetadata *) screenPBv)->add_option ();
+#endif
+	    addOptionFromXMLNode (plugin, child, isScreen,
+				  group ? group : "",
+				  subGroup ? subGroup : "",
 				  groupListPBv, subgroupListPBv, optionPBv);
 	}
+	else if ((!strcmp (childName, "group") && !group && !subGroup) ||
+		 (!strcmp (childName, "subgroup") && !subGroup))
+	{
+	    Bool isGroup = (childName[0] == 'g');
+	    char *desc;
+
+	    if (basicMetadata)
+		desc = strdup ("");
+	    else
+		desc = stringFromChildDefTrans (child, "short", "");
+
+	    if (!desc)
+		continue;
+
+	    if (isGroup)
+		addOptionsFromXMLNode (plugin, child, isScreen,
+				       desc, NULL, screenPBv);
+	    else
+		addOptionsFromXMLNode (plugin, child, isScreen,
+				       group, desc, screenPBv);
+	    free (desc);
+	}
+    }
+}
+
+static void
+initDisplayScreenFromRootNode (CCSPlugin * plugin,
+			       xmlNode * node,
+			       Bool isScreen,
+			       void * pluginPBv)
+{
+    void *screenPBv = NULL;
 
-	free (optNodes);
+    node = getChildNode (node, (isScreen ? "screen" : "display"));
+    if (!node)
+	return;
+
+#ifdef USE_PROTOBUF
+    if (pluginPBv)
+    {
+	PluginMetadata *pluginPB = (PluginMetadata *) pluginPBv;
+	screenPBv = (isScreen ?
+		     pluginPB->mutable_screen () :
+		     pluginPB->mutable_display ());
     }
-    free (nodes);
+#endif
+
+    addOptionsFromXMLNode (plugin, node, isScreen, NULL, NULL, screenPBv);
 }
 
 static inline void
@@ -2266,34 +2446,27 @@ initOptionsFromRootNode (CCSPlugin * plugin,
 }
 
 static void
-addStringsFromPath (CCSStringList * list,
-		    const char * path,
-		    xmlNode * node,
-		    void * stringListPBv)
+addStringsFromChildren (CCSContext * context,
+			CCSStringList * list,
+			const char * name,
+			xmlNode * node,
+			void * stringListPBv)
 {
-    xmlNode **nodes;
-    int num, i;
-    nodes = getNodesFromXPath (node->doc, node, path, &num);
+    xmlNode *child;
 
-    if (num)
+    for (child = getChildNode (node, name); child;
+	 child = getNextChildNode (child, name))
     {
-	for (i = 0; i < num; i++)
-	{
-	    char *value = stringFromNodeDef (nodes[i], "child::text()", NULL);
+	char *value = ccsInternOwnedString (context, getNodeText (child));
 
-	    if (value && strlen (value))
-	    {
-		*list = ccsStringListAppend (*list, value);
+	if (value)
+	{
+	    *list = ccsStringListAppend (*list, value);
 #ifdef USE_PROTOBUF
-		if (stringListPBv)
-		    ((StringList *) stringListPBv)->Add ()->assign (value);
+	    if (stringListPBv)
+		((StringList *) stringListPBv)->Add ()->assign (value);
 #endif
-	    }
-	    if (value && !strlen (value))
-		free (value);
 	}
-
-	free (nodes);
     }
 }
 
@@ -2302,8 +2475,7 @@ addStringExtensionFromXMLNode (CCSPlugin * plugin,
 			       xmlNode * node,
 			       void * extensionPBv)
 {
-    xmlNode **nodes;
-    int num, j;
+    xmlNode *child;
     CCSStrExtension *extension;
     char *name;
     char *value;
@@ -2314,7 +2486,7 @@ addStringExtensionFromXMLNode (CCSPlugin * plugin,
     if (!extension)
 	return;
 
-    isDisplay = getStringFromXPath (node->doc, node, "@display");
+    isDisplay = getAttribute (node, "display");
 
     extension->isScreen = !(isDisplay && !strcmp (isDisplay, "true"));
 
@@ -2323,7 +2495,7 @@ addStringExtensionFromXMLNode (CCSPlugin * plugin,
 
     extension->restriction = NULL;
 
-    extension->basePlugin = getStringFromXPath (node->doc, node, "@base_plugin");
+    extension->basePlugin = getAttribute (node, "base_plugin");
     if (!extension->basePlugin)
 	extension->basePlugin = strdup ("");
 
@@ -2338,23 +2510,22 @@ addStringExtensionFromXMLNode (CCSPlugin * plugin,
     }
 #endif
 
-    addStringsFromPath (&extension->baseSettings, "base_option", node,
-			stringListPBv);
+    addStringsFromChildren (plugin->context, &extension->baseSettings,
+			    "base_option", node, stringListPBv);
 
-    nodes = getNodesFromXPath (node->doc, node, "restriction", &num);
-    if (!num)
+    child = getChildNode (node, "restriction");
+    if (!child)
     {
 	free (extension);
 	return;
     }
 
-    for (j = 0; j < num; j++)
+    for (; child; child = getNextChildNode (child, "restriction"))
     {
-	value = getStringFromXPath (node->doc, nodes[j], "value/child::text()");
+	value = getChildText (child, "value");
 	if (value)
 	{
-	    name = stringFromNodeDefTrans (nodes[j], "name/child::text()",
-					   NULL);
+	    name = stringFromChildDefTrans (child, "name", NULL);
 	    if (name)
 	    {
 		ccsAddRestrictionToStringExtension (extension, name, value);
@@ -2372,7 +2543,6 @@ addStringExtensionFromXMLNode (CCSPlugin * plugin,
 	    free (value);
 	}
     }
-    free (nodes);
 
     PLUGIN_PRIV (plugin);
 
@@ -2385,28 +2555,49 @@ initStringExtensionsFromRootNode (CCSPlugin * plugin,
 				  xmlNode * node,
 				  void * pluginPBv)
 {
-    xmlNode **nodes;
-    int num, i;
-    nodes = getNodesFromXPath (node->doc, node, "/compiz/*/extension", &num);
+    xmlNode *root, *child, *extNode;
+
+    /* The extension children of every element below the compiz root */
+    root = xmlDocGetRootElement (node->doc);
+    if (!root || strcmp ((const char *) root->name, "compiz"))
+	return;
 
-    for (i = 0; i < num; i++)
+    for (child = root->children; child; child = child->next)
     {
-	void *extensionPBv = NULL;
-#ifdef USE_PROTOBUF
-	if (pluginPBv)
+	if (child->type != XML_ELEMENT_NODE)
+	    continue;
+
+	for (extNode = getChildNode (child, "extension"); extNode;
+	     extNode = getNextChildNode (extNode, "extension"))
 	{
-	    PluginMetadata *pluginPB = (PluginMetadata *) pluginPBv;
-	    extensionPBv = pluginPB->add_extension ();
-	}
+	    void *extensionPBv = NULL;
+#ifdef USE_PROTOBUF
+	    if (pluginPBv)
+	    {
+		PluginMetadata *pluginPB = (PluginMetadata *) pluginPBv;
+		extensionPBv = pluginPB->add_extension ();
+	    }
 #endif
-	addStringExtensionFromXMLNode (plugin, nodes[i], extensionPBv);
+	    addStringExtensionFromXMLNode (plugin, extNode, extensionPBv);
+	}
     }
-    free (nodes);
+}
+
+static inline void
+initOptionsStringExtensionsFromRootNode (CCSPlugin * plugin,
+					 xmlNode * node,
+					 void * pluginPBv)
+{
+    initOptionsFromRootNode (plugin, node, pluginPBv);
+    if (!basicMetadata)
+	initStringExtensionsFromRootNode (plugin, node, pluginPBv);
 }
 
 static void
 initRulesFromRootNode (CCSPlugin * plugin, xmlNode * node, void * pluginInfoPBv)
 {
+    CCSContext *context = plugin->context;
+    xmlNode *deps, *child;
     void *featureListPBv = NULL;
     void *pluginAfterListPBv = NULL;
     void *pluginBeforeListPBv = NULL;
@@ -2430,23 +2621,52 @@ initRulesFromRootNode (CCSPlugin * plugin, xmlNode * node, void * pluginInfoPBv)
     }
 #endif
 
-    addStringsFromPath (&plugin->providesFeature, "feature", node,
-			featureListPBv);
+    addStringsFromChildren (context, &plugin->providesFeature, "feature",
+			    node, featureListPBv);
+
+    /* One walk over the deps, each list still gets its entries in
+       document order */
+    for (deps = getChildNode (node, "deps"); deps;
+	 deps = getNextChildNode (deps, "deps"))
+    {
+	for (child = deps->children; child; child = child->next)
+	{
+	    const char *childName = (const char *) child->name;
+
+	    if (child->type != XML_ELEMENT_NODE)
+		continue;
 
-    addStringsFromPath (&plugin->loadAfter,
-			"deps/relation[@type = 'after']/plugin", node,
-			pluginAfterListPBv);
-    addStringsFromPath (&plugin->loadBefore,
-			"deps/relation[@type = 'before']/plugin", node,
-			pluginBeforeListPBv);
-    addStringsFromPath (&plugin->requiresPlugin,
-			"deps/requirement/plugin", node, requirePluginListPBv);
-    addStringsFromPath (&plugin->requiresFeature,
-			"deps/requirement/feature", node, requireFeatureListPBv);
-    addStringsFromPath (&plugin->conflictPlugin,
-			"deps/conflict/plugin", node, conflictPluginListPBv);
-    addStringsFromPath (&plugin->conflictFeature,
-			"deps/conflict/feature", node, conflictFeatureListPBv);
+	    if (!strcmp (childName, "relation"))
+	    {
+		char *type = getAttribute (child, "type");
+
+		if (!type)
+		    continue;
+
+		if (!strcmp (type, "after"))
+		    addStringsFromChildren (context, &plugin->loadAfter,
+					    "plugin", child, pluginAfterListPBv);
+		else if (!strcmp (type, "before"))
+		    addStringsFromChildren (context, &plugin->loadBefore,
+					    "plugin", child, pluginBeforeListPBv);
+		free (type);
+	    }
+	    else if (!strcmp (childName, "requirement"))
+	    {
+		addStringsFromChildren (context, &plugin->requiresPlugin,
+					"plugin", child, requirePluginListPBv);
+		addStringsFromChildren (context, &plugin->requiresFeature,
+					"feature", child, requireFeatureListPBv);
+	    }
+	    else if (!strcmp (childName, "conflict"))
+	    {
+		addStringsFromChildren (context, &plugin->conflictPlugin,
+					"plugin", child, conflictPluginListPBv);
+		addStringsFromChildren (context, &plugin->conflictFeature,
+					"feature", child, conflictFeatureListPBv);
+	    }
+	}
+    }
 }
 
 #ifdef USE_PROTOBUF
@@ -2463,8 +2683,8 @@ fillBasicInfoIntoPB (CCSPlugin *plugin, PluginInfoMetadata *pluginInfoPB)
 }
 #endif
 
-/* Returns TRUE on success. */
-static Bool
+/* Returns the new plugin, which isn't added to the context yet */
+static CCSPlugin *
 addPluginFromXMLNode (CCSContext * context,
 		      xmlNode * node,
 		      char * file,
@@ -2475,39 +2695,37 @@ addPluginFromXMLNode (CCSContext * context,
     CCSPluginPrivate *pPrivate;
 
     if (!node)
-	return FALSE;
+	return NULL;
 
-    name = getStringFromXPath (node->doc, node, "@name");
+    name = getAttribute (node, "name");
 
     if (!name || !strlen (name))
     {
 	if (name)
 	    free (name);
-	return FALSE;
+	return NULL;
     }
 
     if (!strcmp (name, "ini") || !strcmp (name, "gconf") ||
 	!strcmp (name, "ccp") || !strcmp (name, "kconfig"))
     {
 	free (name);
-	return FALSE;
+	return NULL;
     }
 
-    if (ccsFindPlugin (context, name))
+    plugin = (CCSPlugin *) calloc (1, sizeof (CCSPlugin));
+    if (!plugin)
     {
 	free (name);
-	return FALSE;
+	return NULL;
     }
 
-    plugin = (CCSPlugin *) calloc (1, sizeof (CCSPlugin));
-    if (!plugin)
-	return FALSE;
-
     pPrivate = (CCSPluginPrivate *) calloc (1, sizeof (CCSPluginPrivate));
     if (!pPrivate)
     {
+	free (name);
 	free (plugin);
-	return FALSE;
+	return NULL;
     }
 
     plugin->ccsPrivate = (void *) pPrivate;
@@ -2522,17 +2740,18 @@ addPluginFromXMLNode (CCSContext * context,
     if (!basicMetadata)
     {
 	plugin->shortDesc =
-	    stringFromNodeDefTrans (node, "short/child::text()", name);
+	    stringFromChildDefTrans (node, "short", name);
 	plugin->longDesc =
-	    stringFromNodeDefTrans (node, "long/child::text()",	name);
+	    stringFromChildDefTrans (node, "long",	name);
 	plugin->category =
-	    stringFromNodeDef (node, "category/child::text()", "");
+	    ccsInternOwnedString (context,
+				  stringFromChildDef (node, "category", ""));
     }
     else
     {
 	plugin->shortDesc = strdup (name);
 	plugin->longDesc  = strdup (name);
-	plugin->category  = strdup ("");
+	plugin->category  = ccsInternString (context, "");
     }
 #ifdef USE_PROTOBUF
     fillBasicInfoIntoPB (plugin, (PluginInfoMetadata *) pluginInfoPBv);
@@ -2540,14 +2759,13 @@ addPluginFromXMLNode (CCSContext * context,
 
     initRulesFromRootNode (plugin, node, pluginInfoPBv);
 
-    context->plugins = ccsPluginListAppend (context->plugins, plugin);
     free (name);
 
-    return TRUE;
+    return plugin;
 }
 
-/* Returns TRUE on success. */
-static Bool
+/* Returns the core plugin, which isn't added to the context yet */
+static CCSPlugin *
 addCoreSettingsFromXMLNode (CCSContext * context,
 			    xmlNode * node,
 			    char *file,
@@ -2557,20 +2775,17 @@ addCoreSettingsFromXMLNode (CCSContext * context,
     CCSPluginPrivate *pPrivate;
 
     if (!node)
-	return FALSE;
-
-    if (ccsFindPlugin (context, "core"))
-	return FALSE;
+	return NULL;
 
     plugin = (CCSPlugin *) calloc (1, sizeof (CCSPlugin));
     if (!plugin)
-	return FALSE;
+	return NULL;
 
     pPrivate = (CCSPluginPrivate *) calloc (1, sizeof (CCSPluginPrivate));
     if (!pPrivate)
     {
 	free (plugin);
-	return FALSE;
+	return NULL;
     }
 
     plugin->ccsPrivate = (void *) pPrivate;
@@ -2581,15 +2796,15 @@ addCoreSettingsFromXMLNode (CCSContext * context,
     pPrivate->xmlPath = strdup ("/compiz/core");
     plugin->context = context;
     plugin->name = strdup ("core");
-    plugin->category = strdup ("General");
+    plugin->category = ccsInternString (context, "General");
 
     if (!basicMetadata)
     {
 	plugin->shortDesc =
-	    stringFromNodeDefTrans (node, "short/child::text()",
+	    stringFromChildDefTrans (node, "short",
 				    "General Options");
 	plugin->longDesc =
-	    stringFromNodeDefTrans (node, "long/child::text()",
+	    stringFromChildDefTrans (node, "long",
 				    "General Compiz Options");
     }
     else
@@ -2602,9 +2817,8 @@ addCoreSettingsFromXMLNode (CCSContext * context,
 #endif
 
     initRulesFromRootNode (plugin, node, pluginInfoPBv);
-    context->plugins = ccsPluginListAppend (context->plugins, plugin);
 
-    return TRUE;
+    return plugin;
 }
 
 /* End of XML parsing */
@@ -2634,18 +2848,12 @@ loadPluginMetadataFromProtoBuf (char *pbPath,
     return success;
 }
 
-// Returns TRUE if successfully loads .pb file and .pb is up to date.
+// Returns TRUE if the .pb described by pluginInfoPB is up to date.
 static Bool
-checkAndLoadProtoBuf (char *pbPath,
-		      struct stat *pbStat,
-		      struct stat *xmlStat,
-		      PluginBriefMetadata *pluginBriefPB)
+pbInfoIsCurrent (const PluginInfoMetadata &pluginInfoPB,
+		 struct stat *xmlStat)
 {
-    const PluginInfoMetadata &pluginInfoPB = pluginBriefPB->info ();
-
-    if (pbStat->st_mtime < xmlStat->st_mtime ||     // is .pb older than .xml?
-	!loadPluginMetadataFromProtoBuf (pbPath, pluginBriefPB, NULL) ||
-	(!basicMetadata && pluginBriefPB->info ().basic_metadata ()) ||
+    if ((!basicMetadata && pluginInfoPB.basic_metadata ()) ||
 	pluginInfoPB.pb_abi_version () != PB_ABI_VERSION ||
 	pluginInfoPB.time () != (unsigned long)xmlStat->st_mtime ||
 	// xml modification time mismatch?
@@ -2662,28 +2870,17 @@ checkAndLoadProtoBuf (char *pbPath,
 static void
 writePBFile (char *pbFilePath,
 	     PluginMetadata *pluginPB,
-	     PluginBriefMetadata *pluginBriefPB,
 	     struct stat *xmlStat)
 {
     if (!createProtoBufCacheDir ())
 	return;
 
-    PluginInfoMetadata *pluginInfoPB;
-
-    if (pluginPB)
-    {
-	pluginInfoPB = pluginPB->mutable_info ();
-	pluginInfoPB->set_brief_metadata (FALSE);
-    }
-    else
-    {
-	pluginInfoPB = pluginBriefPB->mutable_info ();
-	pluginInfoPB->set_pb_abi_version (PB_ABI_VERSION);
-	pluginInfoPB->set_locale (shortLocale);
-	pluginInfoPB->set_time ((unsigned long)xmlStat->st_mtime);
-	pluginInfoPB->set_brief_metadata (TRUE);
-    }
+    PluginInfoMetadata *pluginInfoPB = pluginPB->mutable_info ();
 
+    pluginInfoPB->set_pb_abi_version (PB_ABI_VERSION);
+    pluginInfoPB->set_locale (shortLocale);
+    pluginInfoPB->set_time ((unsigned long)xmlStat->st_mtime);
+    pluginInfoPB->set_brief_metadata (FALSE);
     pluginInfoPB->set_basic_metadata (basicMetadata);
 
     FILE *pbFile = fopen (pbFilePath, "wb");
@@ -2691,50 +2888,296 @@ writePBFile (char *pbFilePath,
     {
 	google::protobuf::io::FileOutputStream
 	    outputStream (fileno (pbFile));
-	if (pluginPB)
-	    pluginPB->SerializeToZeroCopyStream (&outputStream);
-	else
-	    pluginBriefPB->SerializeToZeroCopyStream (&outputStream);
+	pluginPB->SerializeToZeroCopyStream (&outputStream);
 	outputStream.Close ();
     }
 }
+
+static char *
+bundleFilePath ()
+{
+    return strdup_printf ("%s/bundle.pb", metadataCacheDir.c_str ());
+}
+
+// Loads the bundle and indexes its sources. Returns FALSE if there is no
+// bundle or it doesn't match the current settings.
+static Bool
+loadBundle (BundleMetadata *bundle, BundleIndex *index)
+{
+    Bool success = FALSE;
+    char *path;
+
+    if (!createProtoBufCacheDir ())
+	return FALSE;
+
+    path = bundleFilePath ();
+    if (!path)
+	return FALSE;
+
+    int fd = open (path, O_RDONLY);
+    free (path);
+    if (fd < 0)
+	return FALSE;
+
+    google::protobuf::io::FileInputStream inputStream (fd);
+    inputStream.SetCloseOnDelete (true);
+    if (bundle->ParseFromZeroCopyStream (&inputStream) &&
+	bundle->pb_abi_version () == PB_ABI_VERSION &&
+	(basicMetadata || !bundle->basic_metadata ()) &&
+	(bundle->locale () == "NONE" || bundle->locale () == shortLocale))
+	success = TRUE;
+
+    if (!success)
+    {
+	bundle->Clear ();
+	return FALSE;
+    }
+
+    for (int i = 0; i < bundle->directory_size (); i++)
+    {
+	const BundleDirectoryMetadata &dir = bundle->directory (i);
+
+	for (int j = 0; j < dir.source_size (); j++)
+	    (*index)[dir.source (j).path ()] = &dir.source (j);
+    }
+
+    return TRUE;
+}
+
+// Returns TRUE if the source still describes the .xml file
+static Bool
+bundleSourceIsCurrent (const BundleSourceMetadata *source,
+		       struct stat *xmlStat)
+{
+    return (source->inode () == (unsigned long)xmlStat->st_ino &&
+	    source->size () == (unsigned long)xmlStat->st_size &&
+	    source->time () == (unsigned long)xmlStat->st_mtime);
+}
+
+// Replaces the source with the same path in bundle, or adds it
+static void
+updateBundleSource (BundleMetadata *bundle,
+		    const char *xmlDirPath,
+		    const BundleSourceMetadata *source)
+{
+    BundleDirectoryMetadata *dir = NULL;
+
+    for (int i = 0; i < bundle->directory_size () && !dir; i++)
+	if (bundle->directory (i).path () == xmlDirPath)
+	    dir = bundle->mutable_directory (i);
+
+    if (!dir)
+    {
+	dir = bundle->add_directory ();
+	dir->set_path (xmlDirPath);
+    }
+
+    for (int i = 0; i < dir->source_size (); i++)
+	if (dir->source (i).path () == source->path ())
+	{
+	    dir->mutable_source (i)->CopyFrom (*source);
+	    return;
+	}
+
+    dir->add_source ()->CopyFrom (*source);
+}
+
+// Writes the bundle through a temporary file, so that concurrent readers
+// never see a partial one
+static void
+writeBundle (BundleMetadata *bundle)
+{
+    char *path, *tmpPath;
+    bool success = false;
+
+    if (!createProtoBufCacheDir ())
+	return;
+
+    bundle->set_pb_abi_version (PB_ABI_VERSION);
+    bundle->set_locale (shortLocale);
+    bundle->set_basic_metadata (basicMetadata);
+
+    path = bundleFilePath ();
+    if (!path)
+	return;
+
+    tmpPath = strdup_printf ("%s.%d.tmp", path, (int) getpid ());
+    if (!tmpPath)
+    {
+	free (path);
+	return;
+    }
+
+    int fd = open (tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0)
+    {
+	google::protobuf::io::FileOutputStream outputStream (fd);
+
+	success = bundle->SerializeToZeroCopyStream (&outputStream);
+	success = outputStream.Close () && success;
+    }
+
+    if (!success || rename (tmpPath, path))
+	unlink (tmpPath);
+
+    free (tmpPath);
+    free (path);
+}
 #endif
 
-/* Returns TRUE on success. */
+/* Elements of a plugin that make up its brief metadata */
 static Bool
+isBriefMetadataElement (const char *name)
+{
+    return (!strcmp (name, "short") || !strcmp (name, "long") ||
+	    !strcmp (name, "category") || !strcmp (name, "deps") ||
+	    !strcmp (name, "feature"));
+}
+
+/* Returns the plugin described by doc or NULL on failure. Its core or
+   plugin element is returned in pluginNode. */
+static CCSPlugin *
+loadPluginFromXMLDoc (CCSContext * context,
+		      xmlDoc * doc,
+		      char *filename,
+		      void * pluginInfoPBv,
+		      xmlNode ** pluginNode)
+{
+    xmlNode *root, *node;
+
+    root = xmlDocGetRootElement (doc);
+    if (!root || strcmp ((const char *) root->name, "compiz"))
+	return NULL;
+
+    node = getChildNode (root, "core");
+    if (node)
+    {
+	*pluginNode = node;
+	return addCoreSettingsFromXMLNode (context, node, filename,
+					   pluginInfoPBv);
+    }
+
+    node = getChildNode (root, "plugin");
+    if (node)
+    {
+	*pluginNode = node;
+	return addPluginFromXMLNode (context, node, filename, pluginInfoPBv);
+    }
+
+    return NULL;
+}
+
+/* Returns the plugin described by the file or NULL on failure.
+
+   Usually only the brief metadata is needed here, so the file is streamed
+   instead of being read into a full tree: the first core or plugin
+   element is kept with its header. Elements that aren't part of the brief
+   metadata, i.e. the options, are skipped as a whole, since dependencies
+   or features may still follow them.
+
+   If fullDoc is given, the plugin is known to be needed. The whole file
+   is read then and returned in fullDoc and fullNode, so that its options
+   can be read without parsing the file again. */
+static CCSPlugin *
 loadPluginFromXML (CCSContext * context,
-		   xmlDoc * doc,
 		   char *filename,
-		   void * pluginInfoPBv)
+		   void * pluginInfoPBv,
+		   xmlDoc ** fullDoc,
+		   xmlNode ** fullNode)
 {
-    xmlNode **nodes;
-    int num;
-    Bool success = FALSE;
+    xmlTextReaderPtr reader;
+    xmlNode *node = NULL;
+    xmlDoc *doc;
+    CCSPlugin *plugin = NULL;
+    Bool isCore = FALSE;
+    int ret;
+
+    if (fullDoc)
+    {
+	doc = xmlReadFile (filename, NULL, 0);
+	if (!doc)
+	    return NULL;
+
+	plugin = loadPluginFromXMLDoc (context, doc, filename, pluginInfoPBv,
+				       fullNode);
+	if (plugin)
+	    *fullDoc = doc;
+	else
+	    xmlFreeDoc (doc);
 
-    nodes = getNodesFromXPath (doc, NULL, "/compiz/core", &num);
-    if (num)
+	return plugin;
+    }
+
+    reader = xmlReaderForFile (filename, NULL, 0);
+    if (!reader)
+	return NULL;
+
+    ret = xmlTextReaderRead (reader);
+    while (ret == 1)
     {
-	success = addCoreSettingsFromXMLNode (context, nodes[0], filename,
-					      pluginInfoPBv);
-	free (nodes);
-	return success;
+	const char *name;
+	int depth;
+
+	if (xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT)
+	{
+	    ret = xmlTextReaderRead (reader);
+	    continue;
+	}
+
+	name = (const char *) xmlTextReaderConstLocalName (reader);
+	depth = xmlTextReaderDepth (reader);
+
+	if (depth == 0)
+	{
+	    if (strcmp (name, "compiz"))
+		break;
+	}
+	else if (depth == 1)
+	{
+	    if (node)
+		break;
+
+	    isCore = !strcmp (name, "core");
+	    if (isCore || !strcmp (name, "plugin"))
+	    {
+		node = xmlTextReaderCurrentNode (reader);
+		/* Keeps the nodes read from here on in the tree */
+		xmlTextReaderPreserve (reader);
+	    }
+	}
+	else if (depth == 2 && node && !isBriefMetadataElement (name))
+	{
+	    /* Moves on to the next sibling without visiting the subtree */
+	    ret = xmlTextReaderNext (reader);
+	    continue;
+	}
+
+	ret = xmlTextReaderRead (reader);
     }
 
-    nodes = getNodesFromXPath (doc, NULL, "/compiz/plugin", &num);
-    if (num)
+    if (node && ret >= 0)
     {
-	success = addPluginFromXMLNode (context, nodes[0], filename,
-					pluginInfoPBv);
-	free (nodes);
+	if (isCore)
+	    plugin = addCoreSettingsFromXMLNode (context, node, filename,
+						 pluginInfoPBv);
+	else
+	    plugin = addPluginFromXMLNode (context, node, filename,
+					   pluginInfoPBv);
     }
-    return success;
+
+    /* The reader leaves the tree to us once we have asked for it */
+    doc = xmlTextReaderCurrentDoc (reader);
+    xmlFreeTextReader (reader);
+    if (doc)
+	xmlFreeDoc (doc);
+
+    return plugin;
 }
 
 #ifdef USE_PROTOBUF
 static void
-updatePBFilePath (CCSContext * context, char *name, char *pbFilePath)
+updatePBFilePath (CCSPlugin * plugin, char *pbFilePath)
 {
-    CCSPlugin *plugin = ccsFindPlugin (context, name);
     if (plugin)
     {
 	PLUGIN_PRIV (plugin);
@@ -2746,14 +3189,66 @@ updatePBFilePath (CCSContext * context, char *name, char *pbFilePath)
 }
 #endif
 
+typedef struct _PluginLoadJob
+{
+    const char *xmlDirPath;
+    const char *xmlName;
+    Bool       full;	/* the settings of the plugin will be needed */
+    CCSPlugin  *plugin;
+#ifdef USE_PROTOBUF
+    const BundleSourceMetadata *cachedSource; /* still current in the bundle */
+    BundleSourceMetadata       *source;       /* read from the .xml instead */
+    PluginMetadata             *fullMetadata; /* options read for full */
+    struct stat                xmlStat;
+#endif
+} PluginLoadJob;
+
+/* Key bindings are parsed with Xlib, which isn't thread safe */
+static pthread_mutex_t optionsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Reads the options of a needed plugin while its file is parsed anyway,
+   so that ccsLoadPluginSettings doesn't have to parse it again. They are
+   kept in job->fullMetadata too, to be cached once the plugin is added. */
 static void
-loadPluginFromXMLFile (CCSContext * context, char *xmlName, char *xmlDirPath)
+loadOptionsFromXMLNode (CCSPlugin * plugin,
+			xmlNode * node,
+			PluginLoadJob * job)
+{
+    void *pluginPBv = NULL;
+
+    PLUGIN_PRIV (plugin);
+
+#ifdef USE_PROTOBUF
+    if (usingProtobuf)
+    {
+	job->fullMetadata = new PluginMetadata;
+	fillBasicInfoIntoPB (plugin, job->fullMetadata->mutable_info ());
+	pluginPBv = job->fullMetadata;
+    }
+#endif
+
+    pthread_mutex_lock (&optionsLock);
+    /* Keeps ccsFindSetting from loading the settings meanwhile */
+    pPrivate->loaded = TRUE;
+    initOptionsStringExtensionsFromRootNode (plugin, node, pluginPBv);
+    pPrivate->loaded = FALSE;
+    pthread_mutex_unlock (&optionsLock);
+
+    pPrivate->optionsLoaded = TRUE;
+}
+
+/* Loads the brief metadata of a plugin from the bundle or its .xml
+   file. Doesn't touch the context, so it may run in parallel for
+   different jobs. The plugin is left in job, not added to the context. */
+static void
+loadPluginFromXMLFile (CCSContext * context, PluginLoadJob * job,
+		       const void * bundleIndexv)
 {
     char *xmlFilePath;
-    char *pbFilePath = NULL;
     void *pluginInfoPBv = NULL;
+    CCSPlugin *plugin = NULL;
 
-    xmlFilePath = strdup_printf ("%s/%s", xmlDirPath, xmlName);
+    xmlFilePath = strdup_printf ("%s/%s", job->xmlDirPath, job->xmlName);
     if (!xmlFilePath)
     {
 	fprintf (stderr, "[ERROR]: Can't allocate memory\n");
@@ -2761,9 +3256,10 @@ loadPluginFromXMLFile (CCSContext * context, char *xmlName, char *xmlDirPath)
     }
 
 #ifdef USE_PROTOBUF
+    const BundleIndex *bundleIndex = (const BundleIndex *) bundleIndexv;
+    char *pbFilePath = NULL;
     char *name = NULL;
     struct stat xmlStat;
-    Bool removePB = FALSE;
 
     if (usingProtobuf)
     {
@@ -2773,11 +3269,7 @@ loadPluginFromXMLFile (CCSContext * context, char *xmlName, char *xmlDirPath)
 	    return;
 	}
 
-	// Check if the corresponding .pb exists in cache
-	Bool error = TRUE;
-	struct stat pbStat;
-
-	name = strndup (xmlName, strlen (xmlName) - 4);
+	name = strndup (job->xmlName, strlen (job->xmlName) - 4);
 	if (!name)
 	{
 	    fprintf (stderr, "[ERROR]: Can't allocate memory\n");
@@ -2785,92 +3277,225 @@ loadPluginFromXMLFile (CCSContext * context, char *xmlName, char *xmlDirPath)
 	    return;
 	}
 
-	if (createProtoBufCacheDir () &&
-	    metadataCacheDir.length () > 0)
+	if (bundleIndex)
 	{
-	    pbFilePath = strdup_printf ("%s/%s.pb", metadataCacheDir.c_str (), name);
-	    if (!pbFilePath)
+	    BundleIndex::const_iterator it = bundleIndex->find (xmlFilePath);
+
+	    if (it != bundleIndex->end () &&
+		bundleSourceIsCurrent (it->second, &xmlStat))
 	    {
-		fprintf (stderr, "[ERROR]: Can't allocate memory\n");
+		// Found in the bundle
+		const BundleSourceMetadata *source = it->second;
+		char *fullPath = (char *) source->full_metadata ().c_str ();
+
+		if (source->has_info () && !strcmp (name, "core"))
+		    plugin = addCoreSettingsFromPB (context, source->info (),
+						    fullPath, xmlFilePath);
+		else if (source->has_info ())
+		    plugin = addPluginFromPB (context, source->info (),
+					      fullPath, xmlFilePath);
+
+		job->cachedSource = source;
+		job->plugin = plugin;
+
 		free (xmlFilePath);
 		free (name);
 		return;
 	    }
-	    error = stat (pbFilePath, &pbStat);
 	}
 
-	if (!error)
+	pbFilePath = strdup_printf ("%s/%s.pb", metadataCacheDir.c_str (),
+				    name);
+	if (!pbFilePath)
 	{
-	    if (checkAndLoadProtoBuf (pbFilePath, &pbStat, &xmlStat,
-				      &persistentPluginBriefPB))
-	    {
-		// Found and loaded .pb
-		if (!strcmp (name, "core"))
-		    addCoreSettingsFromPB (context,
-					   persistentPluginBriefPB.info (),
-					   pbFilePath, xmlFilePath);
-		else
-		    addPluginFromPB (context, persistentPluginBriefPB.info (),
-				     pbFilePath, xmlFilePath);
-		
-		updatePBFilePath (context, name, pbFilePath);
-		
-		free (xmlFilePath);
-		free (pbFilePath);
-		free (name);
-		return;
-	    }
-	    else
-	    {
-		removePB = TRUE;
-	    }
+	    fprintf (stderr, "[ERROR]: Can't allocate memory\n");
+	    free (xmlFilePath);
+	    free (name);
+	    return;
 	}
-	persistentPluginBriefPB.Clear ();
-	pluginInfoPBv = persistentPluginBriefPB.mutable_info ();
+	// The options in the old .pb may be stale too
+	remove (pbFilePath);
+
+	job->source = new BundleSourceMetadata;
+	pluginInfoPBv = job->source->mutable_info ();
+	job->xmlStat = xmlStat;
     }
 #endif
 
     // Load from .xml
     FILE *fp = fopen (xmlFilePath, "r");
-    Bool xmlLoaded = FALSE;
 
     if (fp)
     {
+	xmlDoc *doc = NULL;
+	xmlNode *node = NULL;
+
 	fclose (fp);
-	xmlDoc *doc = xmlReadFile (xmlFilePath, NULL, 0);
+	plugin = loadPluginFromXML (context, xmlFilePath, pluginInfoPBv,
+				    job->full ? &doc : NULL, &node);
 	if (doc)
 	{
-	    xmlLoaded = loadPluginFromXML (context, doc, xmlFilePath,
-					   pluginInfoPBv);
+	    loadOptionsFromXMLNode (plugin, node, job);
 	    xmlFreeDoc (doc);
 	}
     }
-    free (xmlFilePath);
 
 #ifdef USE_PROTOBUF
-    if (usingProtobuf && xmlLoaded)
+    if (usingProtobuf)
     {
-	if (removePB)
-	    remove (pbFilePath); // Attempt to remove .pb
-	writePBFile (pbFilePath, NULL, &persistentPluginBriefPB, &xmlStat);
-	updatePBFilePath (context, name, pbFilePath);
-    }
+	BundleSourceMetadata *source = job->source;
+
+	source->set_path (xmlFilePath);
+	source->set_inode (xmlStat.st_ino);
+	source->set_size (xmlStat.st_size);
+	source->set_time (xmlStat.st_mtime);
+	source->set_full_metadata (pbFilePath);
+	if (plugin)
+	{
+	    PluginInfoMetadata *pluginInfoPB = source->mutable_info ();
+
+	    pluginInfoPB->set_pb_abi_version (PB_ABI_VERSION);
+	    pluginInfoPB->set_locale (shortLocale);
+	    pluginInfoPB->set_time ((unsigned long)xmlStat.st_mtime);
+	    pluginInfoPB->set_brief_metadata (TRUE);
+	    pluginInfoPB->set_basic_metadata (basicMetadata);
+	    updatePBFilePath (plugin, pbFilePath);
+	}
+	else
+	    source->clear_info ();
 
-    if (pbFilePath)
 	free (pbFilePath);
-    if (name)
 	free (name);
+    }
 #endif
+    free (xmlFilePath);
+
+    job->plugin = plugin;
 }
 
+/* Adds the plugin of a finished job to the context, unless one with the
+   same name was added before */
 static void
-loadPluginsFromXMLFiles (CCSContext * context, char *path)
+addLoadedPlugin (CCSContext * context, PluginLoadJob * job)
 {
-    struct dirent **nameList;
-    int nFile, i;
+    CCSPlugin *plugin = job->plugin;
+    Bool added = FALSE;
+
+    if (plugin)
+    {
+	added = !ccsFindPlugin (context, plugin->name);
+	if (added)
+	    ccsAddPluginToContext (context, plugin);
+	else
+	    ccsFreePlugin (plugin);
+    }
+
+#ifdef USE_PROTOBUF
+    if (job->fullMetadata)
+    {
+	if (added)
+	{
+	    PLUGIN_PRIV (plugin);
+
+	    writePBFile (pPrivate->pbFilePath, job->fullMetadata,
+			 &job->xmlStat);
+	}
+
+	delete job->fullMetadata;
+	job->fullMetadata = NULL;
+    }
+#endif
+}
+
+/* Upper bound for the threads loading metadata files in parallel */
+#define MAX_LOAD_THREADS 8
+
+typedef struct _PluginLoadQueue
+{
+    CCSContext      *context;
+    PluginLoadJob   *jobs;
+    int             numJobs;
+    int             next;
+    const void      *bundleIndex;
+    pthread_mutex_t lock;
+} PluginLoadQueue;
+
+static void *
+pluginLoadWorker (void *data)
+{
+    PluginLoadQueue *queue = (PluginLoadQueue *) data;
+    int i;
+
+    for (;;)
+    {
+	pthread_mutex_lock (&queue->lock);
+	i = queue->next;
+	if (i < queue->numJobs)
+	    queue->next++;
+	pthread_mutex_unlock (&queue->lock);
+
+	if (i >= queue->numJobs)
+	    break;
+
+	loadPluginFromXMLFile (queue->context, &queue->jobs[i],
+			       queue->bundleIndex);
+    }
+
+    return NULL;
+}
+
+static void
+runPluginLoadQueue (PluginLoadQueue *queue)
+{
+    pthread_t threads[MAX_LOAD_THREADS - 1];
+    long numThreads;
+    int i, started = 0;
+
+    numThreads = sysconf (_SC_NPROCESSORS_ONLN);
+    if (numThreads > MAX_LOAD_THREADS)
+	numThreads = MAX_LOAD_THREADS;
+    if (numThreads > queue->numJobs)
+	numThreads = queue->numJobs;
+
+    pthread_mutex_init (&queue->lock, NULL);
+
+    /* The calling thread is one of the workers and finishes the queue
+       alone if no thread can be started */
+    for (i = 0; i < numThreads - 1; i++)
+    {
+	if (pthread_create (&threads[started], NULL, pluginLoadWorker, queue))
+	    break;
+	started++;
+    }
+
+    pluginLoadWorker (queue);
+
+    for (i = 0; i < started; i++)
+	pthread_join (threads[i], NULL);
+
+    pthread_mutex_destroy (&queue->lock);
+}
+
+/* Loads the metadata files of both paths in parallel. The plugins are
+   added to the context in scandir order, home ones first, so that they
+   take precedence like before. The bundle is rewritten if any file was
+   added, changed or removed. */
+static void
+loadPluginsFromXMLFiles (CCSContext * context, char *homePath,
+			 char *systemPath)
+{
+    char *paths[2] = { homePath, systemPath };
+    struct dirent **nameLists[2];
+    int nFiles[2];
+    PluginLoadQueue queue;
+    int numPaths = 2;
+    int i, j, numJobs = 0;
+#ifdef USE_PROTOBUF
+    BundleMetadata bundle;
+    BundleIndex bundleIndex;
+    Bool bundleLoaded = FALSE;
+#endif
 
-    if (!path)
-	return;
 #if defined(HAVE_SCANDIR_POSIX)
  // POSIX (2008) defines the comparison function like this:
  #define scandir(a,b,c,d) scandir((a), (b), (c), (int(*)(const dirent **, const dirent **))(d));
@@ -2878,17 +3503,114 @@ loadPluginsFromXMLFiles (CCSContext * context, char *path)
  #define scandir(a,b,c,d) scandir((a), (b), (c), (int(*)(const void*,const void*))(d));
 #endif
 
-    nFile = scandir (path, &nameList, pluginXMLFilter, NULL);
+    for (i = 0; i < numPaths; i++)
+    {
+	nFiles[i] = 0;
+	if (paths[i])
+	    nFiles[i] = scandir (paths[i], &nameLists[i], pluginXMLFilter, NULL);
+	if (nFiles[i] > 0)
+	    numJobs += nFiles[i];
+	else
+	    nFiles[i] = 0;
+    }
 
-    if (nFile <= 0)
+    if (!numJobs)
 	return;
 
-    for (i = 0; i < nFile; i++)
+    queue.context = context;
+    queue.numJobs = numJobs;
+    queue.next = 0;
+    queue.bundleIndex = NULL;
+    queue.jobs = (PluginLoadJob *) calloc (numJobs, sizeof (PluginLoadJob));
+
+    if (queue.jobs)
     {
-	loadPluginFromXMLFile (context, nameList[i]->d_name, path);
-	free (nameList[i]);
+	numJobs = 0;
+	for (i = 0; i < numPaths; i++)
+	    for (j = 0; j < nFiles[i]; j++, numJobs++)
+	    {
+		queue.jobs[numJobs].xmlDirPath = paths[i];
+		queue.jobs[numJobs].xmlName = nameLists[i][j]->d_name;
+		/* The settings of core are read as soon as a context is
+		   created */
+		queue.jobs[numJobs].full =
+		    eagerMetadata ||
+		    !strcmp (nameLists[i][j]->d_name, "core.xml");
+	    }
+
+#ifdef USE_PROTOBUF
+	/* Shared state the workers rely on */
+	if (usingProtobuf)
+	    bundleLoaded = loadBundle (&bundle, &bundleIndex);
+	if (bundleLoaded)
+	    queue.bundleIndex = &bundleIndex;
+#endif
+	xmlInitParser ();
+
+	runPluginLoadQueue (&queue);
+
+	for (i = 0; i < numJobs; i++)
+	    addLoadedPlugin (context, &queue.jobs[i]);
+
+#ifdef USE_PROTOBUF
+	if (usingProtobuf)
+	{
+	    unsigned int numCached = 0;
+	    Bool changed = !bundleLoaded;
+
+	    for (i = 0; i < numJobs; i++)
+	    {
+		if (queue.jobs[i].source)
+		    changed = TRUE;
+		else if (queue.jobs[i].cachedSource)
+		    numCached++;
+	    }
+
+	    // Removed files leave stale sources behind
+	    if (numCached != bundleIndex.size ())
+		changed = TRUE;
+
+	    if (changed)
+	    {
+		BundleMetadata newBundle;
+		BundleDirectoryMetadata *dir = NULL;
+
+		for (i = 0; i < numJobs; i++)
+		{
+		    PluginLoadJob *job = &queue.jobs[i];
+
+		    if (!dir || dir->path () != job->xmlDirPath)
+		    {
+			dir = newBundle.add_directory ();
+			dir->set_path (job->xmlDirPath);
+		    }
+
+		    if (job->cachedSource)
+			dir->add_source ()->CopyFrom (*job->cachedSource);
+		    else if (job->source)
+			dir->add_source ()->Swap (job->source);
+		}
+
+		writeBundle (&newBundle);
+	    }
+
+	    for (i = 0; i < numJobs; i++)
+		delete queue.jobs[i].source;
+	}
+#endif
+
+	free (queue.jobs);
+    }
+    else
+	fprintf (stderr, "[ERROR]: Can't allocate memory\n");
+
+    for (i = 0; i < numPaths; i++)
+    {
+	for (j = 0; j < nFiles[i]; j++)
+	    free (nameLists[i][j]);
+	if (nFiles[i])
+	    free (nameLists[i]);
     }
-    free (nameList);
 }
 
 static void
@@ -2925,11 +3647,10 @@ addPluginNamed (CCSContext * context, char *name)
     if (!plugin->longDesc)
 	plugin->longDesc = strdup (name);
     if (!plugin->category)
-	plugin->category = strdup ("");
+	plugin->category = ccsInternString (context, "");
 
     pPrivate->loaded = TRUE;
-    collateGroups (pPrivate);
-    context->plugins = ccsPluginListAppend (context->plugins, plugin);
+    ccsAddPluginToContext (context, plugin);
 }
 
 static void
@@ -2983,26 +3704,62 @@ ccsLoadPlugin (CCSContext * context, char *name)
     initPBLoading ();
 #endif
 
+    char *paths[2] = { NULL, (char *) METADATADIR };
+    const void *bundleIndexv = NULL;
+    int i;
+#ifdef USE_PROTOBUF
+    BundleMetadata bundle;
+    BundleIndex bundleIndex;
+    Bool changed = FALSE;
+
+    if (usingProtobuf && loadBundle (&bundle, &bundleIndex))
+	bundleIndexv = &bundleIndex;
+#endif
+
     char *xmlName = strdup_printf ("%s.xml", name);
 
     if (xmlName)
     {
 	const char *home = getenv ("HOME");
 	if (home && strlen (home) > 0)
+	    paths[0] = strdup_printf ("%s/.compiz/metadata", home);
+
+	for (i = 0; i < 2; i++)
 	{
-	    char *xmlDirPath = strdup_printf ("%s/.compiz/metadata", home);
+	    PluginLoadJob job;
+
+	    if (!paths[i])
+		continue;
+
+	    memset (&job, 0, sizeof (PluginLoadJob));
+	    job.xmlDirPath = paths[i];
+	    job.xmlName = xmlName;
+	    /* A plugin is loaded alone when it is about to be used */
+	    job.full = TRUE;
+
+	    loadPluginFromXMLFile (context, &job, bundleIndexv);
+	    addLoadedPlugin (context, &job);
 
-	    if (xmlDirPath)
+#ifdef USE_PROTOBUF
+	    if (job.source)
 	    {
-		loadPluginFromXMLFile (context, xmlName, xmlDirPath);
-		free (xmlDirPath);
+		updateBundleSource (&bundle, job.xmlDirPath, job.source);
+		delete job.source;
+		changed = TRUE;
 	    }
+#endif
 	}
 
-	loadPluginFromXMLFile (context, xmlName, (char *) METADATADIR);
+	if (paths[0])
+	    free (paths[0]);
 	free (xmlName);
     }
 
+#ifdef USE_PROTOBUF
+    if (changed)
+	writeBundle (&bundle);
+#endif
+
     return (ccsFindPlugin (context, name) != NULL);
 }
 
@@ -3015,17 +3772,14 @@ ccsLoadPlugins (CCSContext * context)
     initPBLoading ();
 #endif
 
+    char *homemetadata = NULL;
     const char *home = getenv ("HOME");
     if (home && strlen (home) > 0)
-    {
-	char *homeplugins = strdup_printf ("%s/.compiz/metadata", home);
-	if (homeplugins)
-	{
-	    loadPluginsFromXMLFiles (context, homeplugins);
-	    free (homeplugins);
-	}
-    }
-    loadPluginsFromXMLFiles (context, (char *)METADATADIR);
+	homemetadata = strdup_printf ("%s/.compiz/metadata", home);
+
+    loadPluginsFromXMLFiles (context, homemetadata, (char *)METADATADIR);
+    if (homemetadata)
+	free (homemetadata);
 
     if (home && strlen (home) > 0)
     {
@@ -3063,44 +3817,228 @@ loadOptionsStringExtensionsFromXML (CCSPlugin * plugin,
     nodes = getNodesFromXPath (doc, NULL, pPrivate->xmlPath, &num);
     if (num)
     {
-	initOptionsFromRootNode (plugin, nodes[0], pluginPBv);
-	if (!basicMetadata)
-	    initStringExtensionsFromRootNode (plugin, nodes[0], pluginPBv);
+	initOptionsStringExtensionsFromRootNode (plugin, nodes[0], pluginPBv);
 	free (nodes);
     }
     if (doc)
 	xmlFreeDoc (doc);
 }
 
+/* Returns the presets of the context, parsing presets.ini again only
+   if it changed since it was parsed last */
+static IniDictionary *
+getPresets (CCSContext * context)
+{
+    const char *presetsFile = SYSCONFDIR "/compizconfig/presets.ini";
+    struct stat presetsStat;
+
+    CONTEXT_PRIV (context);
+
+    if (stat (presetsFile, &presetsStat))
+    {
+	if (cPrivate->presets)
+	{
+	    ccsIniClose (cPrivate->presets);
+	    cPrivate->presets = NULL;
+	}
+	return NULL;
+    }
+
+    if (cPrivate->presets && cPrivate->presetsTime == presetsStat.st_mtime)
+	return cPrivate->presets;
+
+    if (cPrivate->presets)
+	ccsIniClose (cPrivate->presets);
+
+    cPrivate->presets = iniparser_new ((char *) presetsFile);
+    cPrivate->presetsTime = presetsStat.st_mtime;
+
+    return cPrivate->presets;
+}
+
 static void
 loadPresets(CCSPlugin * plugin)
 {
     IniDictionary *presets;
-    const char *presetsFile = SYSCONFDIR "/compizconfig/presets.ini";
+    CCSSettingList sl;
 
     PLUGIN_PRIV (plugin);
 
-    CCSSettingList sl = pPrivate->settings;
+    presets = getPresets (plugin->context);
 
-    presets = iniparser_new ((char *) presetsFile);
+    /* Sections are stored as entries too */
+    if (!presets || !iniparser_find_entry (presets, plugin->name))
+	return;
+
+    /* Only the settings the section has an entry for change */
+    for (sl = pPrivate->settings.head; sl; sl = sl->next)
+	if (ccsIniReadSettingValue (presets, sl->data))
+	    ccsSetAsDefault (sl->data);
+}
 
-    if (presets)
+/* Sets the descriptions of all screen instances of a setting */
+static void
+setOptionDescriptions (CCSPlugin * plugin,
+		       const char * name,
+		       Bool isScreen,
+		       const char * shortDesc,
+		       const char * longDesc)
+{
+    CCSContext *context = plugin->context;
+    char *interned[2];
+    unsigned int i, n = isScreen ? context->numScreens : 1;
+
+    interned[0] = ccsInternString (context, shortDesc);
+    interned[1] = ccsInternString (context, longDesc);
+
+    for (i = 0; i < n; i++)
     {
-	while (sl)
+	CCSSetting *setting =
+	    ccsFindSetting (plugin, name, isScreen,
+			    isScreen ? context->screens[i] : 0);
+
+	if (setting)
 	{
-	    ccsIniReadSetting (presets, sl->data);
-	    ccsSetAsDefault (sl->data);
+	    setting->shortDesc = interned[0];
+	    setting->longDesc = interned[1];
+	}
+    }
+}
+
+/* Walks the options like addOptionsFromXMLNode, only for their
+   descriptions */
+static void
+loadDescriptionsFromXMLNode (CCSPlugin * plugin,
+			     xmlNode * node,
+			     Bool isScreen,
+			     Bool inGroup,
+			     Bool inSubGroup)
+{
+    xmlNode *child;
+
+    for (child = node->children; child; child = child->next)
+    {
+	const char *childName = (const char *) child->name;
+
+	if (child->type != XML_ELEMENT_NODE)
+	    continue;
 
-	    sl = sl->next;
+	if (!strcmp (childName, "option"))
+	{
+	    char *name = getAttribute (child, "name");
+	    char *shortDesc, *longDesc;
+
+	    if (!name)
+		continue;
+
+	    shortDesc = stringFromChildDefTrans (child, "short", name);
+	    longDesc = stringFromChildDefTrans (child, "long", "");
+	    setOptionDescriptions (plugin, name, isScreen, shortDesc, longDesc);
+
+	    free (shortDesc);
+	    free (longDesc);
+	    free (name);
 	}
+	else if (!strcmp (childName, "group") && !inGroup && !inSubGroup)
+	    loadDescriptionsFromXMLNode (plugin, child, isScreen, TRUE, FALSE);
+	else if (!strcmp (childName, "subgroup") && !inSubGroup)
+	    loadDescriptionsFromXMLNode (plugin, child, isScreen,
+					 inGroup, TRUE);
+    }
+}
+
+#ifdef USE_PROTOBUF
+static void
+loadDescriptionsFromPB (CCSPlugin * plugin,
+			const ScreenMetadata & screenPB,
+			Bool isScreen)
+{
+    int numOpt, i;
+
+    numOpt = screenPB.option_size ();
+    for (i = 0; i < numOpt; i++)
+    {
+	const OptionMetadata & option = screenPB.option (i);
+	const char *name = option.name ().c_str ();
+
+	setOptionDescriptions (plugin, name, isScreen,
+			       option.has_short_desc () ?
+			       option.short_desc ().c_str () : name,
+			       option.has_long_desc () ?
+			       option.long_desc ().c_str () : name);
     }
 }
+#endif
+
+/* Reads the descriptions which were left out of the settings of plugin
+   because of lazy descriptions, from the .pb if it is current or else
+   from the .xml */
+void
+ccsLoadPluginDescriptions (CCSPlugin * plugin)
+{
+    xmlDoc *doc;
+    xmlNode **nodes;
+    int num;
+
+    PLUGIN_PRIV (plugin);
+
+    if (!pPrivate->descriptionsPending)
+	return;
+
+    pPrivate->descriptionsPending = FALSE;
+
+#ifdef USE_PROTOBUF
+    struct stat xmlStat;
+
+    initPBLoading ();
+
+    if (usingProtobuf && pPrivate->pbFilePath && pPrivate->xmlFile &&
+	!stat (pPrivate->xmlFile, &xmlStat) &&
+	loadPluginMetadataFromProtoBuf (pPrivate->pbFilePath,
+					NULL, &persistentPluginPB) &&
+	!persistentPluginPB.info ().brief_metadata () &&
+	pbInfoIsCurrent (persistentPluginPB.info (), &xmlStat))
+    {
+	if (persistentPluginPB.has_display ())
+	    loadDescriptionsFromPB (plugin, persistentPluginPB.display (),
+				    FALSE);
+	if (persistentPluginPB.has_screen ())
+	    loadDescriptionsFromPB (plugin, persistentPluginPB.screen (),
+				    TRUE);
+	return;
+    }
+#endif
+
+    if (!pPrivate->xmlFile)
+	return;
+
+    doc = xmlReadFile (pPrivate->xmlFile, NULL, 0);
+    if (!doc)
+	return;
+
+    nodes = getNodesFromXPath (doc, NULL, pPrivate->xmlPath, &num);
+    if (num)
+    {
+	xmlNode *node;
+
+	node = getChildNode (nodes[0], "display");
+	if (node)
+	    loadDescriptionsFromXMLNode (plugin, node, FALSE, FALSE, FALSE);
+
+	node = getChildNode (nodes[0], "screen");
+	if (node)
+	    loadDescriptionsFromXMLNode (plugin, node, TRUE, FALSE, FALSE);
+
+	free (nodes);
+    }
+
+    xmlFreeDoc (doc);
+}
 
 void
 ccsLoadPluginSettings (CCSPlugin * plugin)
 {
     Bool ignoreXML = FALSE;
-    Bool loadedAtLeastBriefPB = FALSE;
     void *pluginPBToWrite = NULL;
 
 #ifdef USE_PROTOBUF
@@ -3115,46 +4053,48 @@ ccsLoadPluginSettings (CCSPlugin * plugin)
     pPrivate->loaded = TRUE;
     D (D_FULL, "Initializing %s options...", plugin->name);
 
+    struct stat xmlStat;
+
+    // Already read while enumerating the plugin
+    if (pPrivate->optionsLoaded)
+	ignoreXML = TRUE;
+
 #ifdef USE_PROTOBUF
-    if (usingProtobuf && pPrivate->pbFilePath)
+    // The .pb is written here or after enumerating a needed plugin, so it
+    // has to be checked against the .xml here too
+    if (!ignoreXML && usingProtobuf && pPrivate->pbFilePath &&
+	pPrivate->xmlFile && !stat (pPrivate->xmlFile, &xmlStat))
     {
-	loadedAtLeastBriefPB =
-	    loadPluginMetadataFromProtoBuf (pPrivate->pbFilePath,
-					    NULL, &persistentPluginPB);
-	if (loadedAtLeastBriefPB)
+	if (loadPluginMetadataFromProtoBuf (pPrivate->pbFilePath,
+					    NULL, &persistentPluginPB) &&
+	    !persistentPluginPB.info ().brief_metadata () &&
+	    pbInfoIsCurrent (persistentPluginPB.info (), &xmlStat))
 	{
-	    if (!persistentPluginPB.info ().brief_metadata () &&
-		(basicMetadata ||
-		 !persistentPluginPB.info ().basic_metadata ()))
-	    {
-		initOptionsFromPB (plugin, persistentPluginPB);
-		if (!basicMetadata)
-		    initStringExtensionsFromPB (plugin, persistentPluginPB);
-		ignoreXML = TRUE;
-	    }
-	    else
-		pluginPBToWrite = &persistentPluginPB;
+	    initOptionsFromPB (plugin, persistentPluginPB);
+	    if (!basicMetadata)
+		initStringExtensionsFromPB (plugin, persistentPluginPB);
+	    ignoreXML = TRUE;
 	}
 	else
+	{
+	    persistentPluginPB.Clear ();
+	    fillBasicInfoIntoPB (plugin, persistentPluginPB.mutable_info ());
 	    pluginPBToWrite = &persistentPluginPB;
+	}
     }
 #endif
 
-    struct stat xmlStat;
-
     // Load from .xml
     if (!ignoreXML && pPrivate->xmlFile)
 	loadOptionsStringExtensionsFromXML (plugin, pluginPBToWrite, &xmlStat);
 
 #ifdef USE_PROTOBUF
-    if (pluginPBToWrite && pPrivate->pbFilePath && loadedAtLeastBriefPB)
+    if (pluginPBToWrite)
 	writePBFile (pPrivate->pbFilePath, (PluginMetadata *) pluginPBToWrite,
-		     NULL, &xmlStat);
+		     &xmlStat);
 #endif
     D (D_FULL, "done\n");
 
-    collateGroups (pPrivate);
-
     loadPresets (plugin);
 
     ccsReadPluginSettings (plugin);
@@ -48,6 +48,14 @@ typedef struct _FilewatchData
 
 FilewatchData;
 
+#if HAVE_SYS_INOTIFY_H
+/* IN_ATTRIB reports the link count drop of a file which got replaced
+   by renaming another file over it */
+#define WATCH_MASK (IN_MODIFY | IN_MOVE | IN_MOVE_SELF | IN_DELETE_SELF | \
+		    IN_CREATE | IN_DELETE | IN_ATTRIB)
+#define REPLACE_MASK (IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED)
+#endif
+
 static FilewatchData *fwData = NULL;
 static int           fwDataSize = 0;
 static int           inotifyFd = 0;
@@ -67,6 +75,31 @@ findDataIndexById (unsigned int watchId)
     return index;
 }
 
+#if HAVE_SYS_INOTIFY_H
+/* The watch follows the inode rather than the file name, so once the
+   file got replaced (e.g. by an atomic save) or moved away, watch
+   whatever file now has the name. Returns TRUE if the watch changed. */
+static Bool
+retrackFile (int index)
+{
+    int wd;
+
+    wd = inotify_add_watch (inotifyFd, fwData[index].fileName, WATCH_MASK);
+    if (wd == fwData[index].watchDesc)
+	return FALSE;
+
+    if (wd < 0)
+	wd = 0;
+
+    /* the old watch is gone already if its inode was deleted; removing
+       it again just fails */
+    inotify_rm_watch (inotifyFd, fwData[index].watchDesc);
+    fwData[index].watchDesc = wd;
+
+    return TRUE;
+}
+#endif
+
 void ccsCheckFileWatches (void)
 {
 #if HAVE_SYS_INOTIFY_H
@@ -86,8 +119,18 @@ void ccsCheckFileWatches (void)
 	event = (struct inotify_event *) & buf[i];
 
 	for (j = 0; j < fwDataSize; j++)
-	    if ((fwData[j].watchDesc == event->wd) && fwData[j].callback)
+	{
+	    if (fwData[j].watchDesc != event->wd)
+		continue;
+
+	    /* skip attribute changes unless the file was replaced */
+	    if ((event->mask & REPLACE_MASK) && !retrackFile (j) &&
+		!(event->mask & ~IN_ATTRIB))
+		continue;
+
+	    if (fwData[j].callback)
 		(*fwData[j].callback) (fwData[j].watchId, fwData[j].closure);
+	}
 
 	i += sizeof (*event) + event->len;
     }
@@ -121,9 +164,7 @@ unsigned int ccsAddFileWatch (const char            *fileName,
 #if HAVE_SYS_INOTIFY_H
     if (enable)
 	fwData[fwDataSize].watchDesc =
-	    inotify_add_watch (inotifyFd, fileName,
-			       IN_MODIFY | IN_MOVE | IN_MOVE_SELF |
-			       IN_DELETE_SELF | IN_CREATE | IN_DELETE);
+	    inotify_add_watch (inotifyFd, fileName, WATCH_MASK);
     else
 #endif
 	fwData[fwDataSize].watchDesc = 0;
@@ -217,10 +258,8 @@ ccsEnableFileWatch (unsigned int watchId)
 #if HAVE_SYS_INOTIFY_H
     if (!fwData[index].watchDesc)
 	fwData[index].watchDesc =
-	    inotify_add_watch (inotifyFd,
-			       fwData[index].fileName,
-			       IN_MODIFY | IN_MOVE | IN_MOVE_SELF |
-			       IN_DELETE_SELF | IN_CREATE | IN_DELETE);
+	    inotify_add_watch (inotifyFd, fwData[index].fileName,
+			       WATCH_MASK);
 #endif
 }
 
@@ -22,6 +22,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
+#include <strings.h>
 
 #include <ccs.h>
 #include "ccs-private.h"
@@ -92,6 +93,12 @@ ccsIniClose (IniDictionary *dictionary)
     iniparser_free (dictionary);
 }
 
+void
+ccsIniCompact (IniDictionary *dictionary)
+{
+    iniparser_compact (dictionary);
+}
+
 void
 ccsIniSave (IniDictionary *dictionary,
 	    const char    *fileName)
@@ -102,21 +109,80 @@ ccsIniSave (IniDictionary *dictionary,
     iniparser_dump_ini (dictionary, fileName);
 }
 
+void
+ccsIniSetSyncOnSave (Bool sync)
+{
+    iniparser_set_sync (sync);
+}
+
+/* Builds the lowercase "section:entry" dictionary key */
+static char*
+getIniKey (const char *section,
+	   const char *entry)
+{
+    char *key, *c;
+
+    key = strdup_printf ("%s:%s", section, entry);
+    if (!key)
+	return NULL;
+
+    for (c = key; *c; c++)
+	*c = tolower (*c);
+
+    return key;
+}
+
+/* Returns the dictionary key of a setting, building it on first use */
+static char*
+getSettingIniKey (CCSSetting   *setting,
+		  unsigned int *hash)
+{
+    char *key;
+
+    SETTING_PRIV (setting);
+
+    if (!sPrivate->iniKey)
+    {
+	if (setting->isScreen)
+	{
+	    key = strdup_printf ("s%d_%s", setting->screenNum, setting->name);
+	}
+	else
+	    key = strdup_printf ("as_%s", setting->name);
+
+	if (!key)
+	    return NULL;
+
+	sPrivate->iniKey = getIniKey (setting->parent->name, key);
+	free (key);
+
+	if (!sPrivate->iniKey)
+	    return NULL;
+
+	sPrivate->iniKeyHash = iniparser_hash (sPrivate->iniKey);
+    }
+
+    *hash = sPrivate->iniKeyHash;
+
+    return sPrivate->iniKey;
+}
+
 static char*
 getIniString (IniDictionary *dictionary,
 	      const char    *section,
 	      const char    *entry)
 {
-    char *sectionName;
+    char *key;
     char *retValue;
 
-    sectionName = strdup_printf ("%s:%s", section, entry);
-    if (sectionName == NULL)
+    key = getIniKey (section, entry);
+    if (key == NULL)
 	return NULL;
 
-    retValue = iniparser_getstring (dictionary, sectionName, NULL);
+    retValue = iniparser_getstring_hash (dictionary, key,
+					 iniparser_hash (key), NULL);
 
-    free (sectionName);
+    free (key);
 
     return retValue;
 }
@@ -127,18 +193,25 @@ setIniString (IniDictionary *dictionary,
 	      const char    *entry,
 	      const char    *value)
 {
-    char *sectionName;
+    char *key;
 
-    sectionName = strdup_printf ("%s:%s", section, entry);
-    if (sectionName == NULL)
+    key = getIniKey (section, entry);
+    if (key == NULL)
 	return;
 
-    if (!iniparser_find_entry (dictionary, (char*) section))
-	iniparser_add_entry (dictionary, (char*) section, NULL, NULL);
+    /* the section entry is added along with its first key */
+    iniparser_setstr_hash (dictionary, key, iniparser_hash (key),
+			   (char *) value);
 
-    iniparser_setstr (dictionary, sectionName, (char*) value);
+    free (key);
+}
 
-    free (sectionName);
+static Bool
+iniStringToBool (const char *string)
+{
+    return (string[0] == 't' || string[0] == 'T' ||
+	    string[0] == 'y' || string[0] == 'Y' ||
+	    string[0] == '1');
 }
 
 Bool
@@ -206,15 +279,7 @@ ccsIniGetBool (IniDictionary *dictionary,
     retValue = getIniString (dictionary, section, entry);
     if (retValue)
     {
-	if ((retValue[0] == 't') || (retValue[0] == 'T') ||
-	    (retValue[0] == 'y') || (retValue[0] == 'Y') ||
-	    (retValue[0] == '1'))
-	{
-	    *value = TRUE;
-	}
-	else
-	    *value = FALSE;
-
+	*value = iniStringToBool (retValue);
 	return TRUE;
     }
     else
@@ -307,22 +372,16 @@ isEmptyString (char *value)
     return TRUE;
 }
 
-Bool
-ccsIniGetList (IniDictionary       *dictionary,
-   	       const char          *section,
-	       const char          *entry,
-	       CCSSettingValueList *value,
-	       CCSSetting          *parent)
+static Bool
+iniStringToList (char                *valString,
+		 CCSSettingValueList *value,
+		 CCSSetting          *parent)
 {
     CCSSettingValueList list = NULL;
-    char                *valueString, *valueStart, *valString;
+    char                *valueString, *valueStart;
     char                *token;
     int                 nItems = 1, i = 0, len;
 
-    valString = getIniString (dictionary, section, entry);
-    if (!valString)
-	return FALSE;
-
     if (isEmptyString (valString))
     {
 	*value = NULL;
@@ -330,6 +389,9 @@ ccsIniGetList (IniDictionary       *dictionary,
     }
 
     valueString = strdup (valString);
+    if (!valueString)
+	return FALSE;
+
     valueStart = valueString;
 
     /* remove trailing semicolon that we added to be able to differentiate
@@ -397,9 +459,7 @@ ccsIniGetList (IniDictionary       *dictionary,
 
 	    while (token)
 	    {
-		isTrue = (token[0] == 'y' || token[0] == 'Y' || 
-			  token[0] == '1' ||
-			  token[0] == 't' || token[0] == 'T');
+		isTrue = iniStringToBool (token);
 		array[i++] = isTrue;
 		token = strsep (&valueString, ";");
 	    }
@@ -443,7 +503,7 @@ ccsIniGetList (IniDictionary       *dictionary,
     case TypeKey:
 	{
 	    CCSSettingValue *val = NULL;
-	    list = NULL;
+	    CCSSettingValueSeq seq = { NULL, NULL, 0 };
 
 	    while (token)
 	    {
@@ -451,17 +511,19 @@ ccsIniGetList (IniDictionary       *dictionary,
 		if (!val)
 		    break;
 		if (ccsStringToKeyBinding (token, &val->value.asKey))
-		    list = ccsSettingValueListAppend (list, val);
+		    ccsSettingValueSeqAppend (&seq, val);
 		else
 		    free (val);
 		token = strsep (&valueString, ";");
 	    }
+
+	    list = seq.head;
 	}
 	break;
     case TypeButton:
 	{
 	    CCSSettingValue *val = NULL;
-	    list = NULL;
+	    CCSSettingValueSeq seq = { NULL, NULL, 0 };
 
 	    while (token)
 	    {
@@ -469,17 +531,19 @@ ccsIniGetList (IniDictionary       *dictionary,
 		if (!val)
 		    break;
 		if (ccsStringToButtonBinding (token, &val->value.asButton))
-		    list = ccsSettingValueListAppend (list, val);
+		    ccsSettingValueSeqAppend (&seq, val);
 		else
 		    free (val);
 		token = strsep (&valueString, ";");
 	    }
+
+	    list = seq.head;
 	}
 	break;
     case TypeEdge:
 	{
 	    CCSSettingValue *val = NULL;
-	    list = NULL;
+	    CCSSettingValueSeq seq = { NULL, NULL, 0 };
 
 	    while (token)
 	    {
@@ -487,15 +551,17 @@ ccsIniGetList (IniDictionary       *dictionary,
 		if (!val)
 		    break;
 		val->value.asEdge = ccsStringToEdges (token);
-		list = ccsSettingValueListAppend (list, val);
+		ccsSettingValueSeqAppend (&seq, val);
 		token = strsep (&valueString, ";");
 	    }
+
+	    list = seq.head;
 	}
 	break;
     case TypeBell:
 	{
 	    CCSSettingValue *val = NULL;
-	    list = NULL;
+	    CCSSettingValueSeq seq = { NULL, NULL, 0 };
 	    Bool isTrue;
 
 	    while (token)
@@ -504,14 +570,14 @@ ccsIniGetList (IniDictionary       *dictionary,
 		if (!val)
 		    break;
 
-		isTrue = (token[0] == 'y' || token[0] == 'Y' || 
-			  token[0] == '1' ||
-			  token[0] == 't' || token[0] == 'T');
-		
+		isTrue = iniStringToBool (token);
+
 		val->value.asBell = isTrue;
-		list = ccsSettingValueListAppend (list, val);
+		ccsSettingValueSeqAppend (&seq, val);
 		token = strsep (&valueString, ";");
 	    }
+
+	    list = seq.head;
 	}
 	break;
     default:
@@ -524,6 +590,22 @@ ccsIniGetList (IniDictionary       *dictionary,
     return TRUE;
 }
 
+Bool
+ccsIniGetList (IniDictionary       *dictionary,
+   	       const char          *section,
+	       const char          *entry,
+	       CCSSettingValueList *value,
+	       CCSSetting          *parent)
+{
+    char *valString;
+
+    valString = getIniString (dictionary, section, entry);
+    if (!valString)
+	return FALSE;
+
+    return iniStringToList (valString, value, parent);
+}
+
 void
 ccsIniSetString (IniDictionary * dictionary,
 		 const char    * section,
@@ -648,12 +730,9 @@ ccsIniSetBell (IniDictionary *dictionary,
     ccsIniSetBool (dictionary, section, entry, value);
 }
 
-void
-ccsIniSetList (IniDictionary       *dictionary,
-	       const char          *section,
-	       const char          *entry,
-	       CCSSettingValueList value,
-	       CCSSettingType      listType)
+static char*
+iniListToString (CCSSettingValueList value,
+		 CCSSettingType      listType)
 {
     char         *stringBuffer, *valueString;
     char         valueBuffer[100];
@@ -661,7 +740,7 @@ ccsIniSetList (IniDictionary       *dictionary,
 
     stringBuffer = calloc (1, bufferSize);
     if (!stringBuffer)
-	return;
+	return NULL;
 
     while (value)
     {
@@ -710,7 +789,10 @@ ccsIniSetList (IniDictionary       *dictionary,
 	}
 
 	if (!valueString)
-	    return;
+	{
+	    free (stringBuffer);
+	    return NULL;
+	}
 
 	fill = strlen (stringBuffer);
 	/* the + 1 is the semicolon we're going to add */
@@ -720,7 +802,7 @@ ccsIniSetList (IniDictionary       *dictionary,
 	    bufferSize *= 2;
 	    stringBuffer = realloc (stringBuffer, bufferSize);
 	    if (!stringBuffer)
-		return;
+		return NULL;
 
 	    /* properly NULL terminate it */
 	    stringBuffer[fill] = 0;
@@ -740,8 +822,24 @@ ccsIniSetList (IniDictionary       *dictionary,
 	value = value->next;
     }
 
-    setIniString (dictionary, section, entry, stringBuffer);
-    free (stringBuffer);
+    return stringBuffer;
+}
+
+void
+ccsIniSetList (IniDictionary       *dictionary,
+	       const char          *section,
+	       const char          *entry,
+	       CCSSettingValueList value,
+	       CCSSettingType      listType)
+{
+    char *stringBuffer;
+
+    stringBuffer = iniListToString (value, listType);
+    if (stringBuffer)
+    {
+	setIniString (dictionary, section, entry, stringBuffer);
+	free (stringBuffer);
+    }
 }
 
 void ccsIniRemoveEntry (IniDictionary * dictionary,
@@ -749,168 +847,440 @@ void ccsIniRemoveEntry (IniDictionary * dictionary,
 			const char * section,
 			const char * entry)
 {
-    char *sectionName;
+    char *key;
 
-    sectionName = strdup_printf ("%s:%s", section, entry);
-    if (sectionName != NULL)
+    key = getIniKey (section, entry);
+    if (key != NULL)
     {
-	iniparser_unset (dictionary, sectionName);
-	free (sectionName);
+	iniparser_unset_hash (dictionary, key, iniparser_hash (key));
+	free (key);
     }
 }
 
-void
-ccsIniReadSetting (dictionary *d,
-		   CCSSetting *setting)
+/* Reads the value of a setting, leaving it untouched if the dictionary
+   has no valid value for it */
+Bool
+ccsIniReadSettingValue (IniDictionary *dictionary,
+			CCSSetting    *setting)
 {
-    Bool         status = FALSE;
-    char        *keyName;
+    char         *key, *retValue;
+    unsigned int hash;
 
-    if (setting->isScreen)
-	keyName = strdup_printf ("s%d_%s", setting->screenNum, setting->name);
-    else
-	keyName = strdup_printf ("as_%s", setting->name);
+    key = getSettingIniKey (setting, &hash);
+    if (!key)
+	return FALSE;
 
-    if (keyName == NULL)
-	return;
+    retValue = iniparser_getstring_hash (dictionary, key, hash, NULL);
+    if (!retValue)
+	return FALSE;
 
     switch (setting->type)
     {
     case TypeString:
-	{
-	    char *value;
-	    if (ccsIniGetString (d, setting->parent->name,
-				 keyName, &value))
-	    {
-		ccsSetString (setting, value);
-		free (value);
-		status = TRUE;
-	    }
-	}
+	ccsSetString (setting, retValue);
 	break;
     case TypeMatch:
-	{
-	    char *value;
-	    if (ccsIniGetString (d, setting->parent->name,
-				 keyName, &value))
-	    {
-		ccsSetMatch (setting, value);
-		free (value);
-		status = TRUE;
-	    }
-	}
+	ccsSetMatch (setting, retValue);
 	break;
     case TypeInt:
-	{
-	    int value;
-	    if (ccsIniGetInt (d, setting->parent->name,
-			      keyName, &value))
-	    {
-		ccsSetInt (setting, value);
-		status = TRUE;
-	    }
-	}
+	ccsSetInt (setting, strtoul (retValue, NULL, 10));
 	break;
     case TypeBool:
-	{
-	    Bool value;
-	    if (ccsIniGetBool (d, setting->parent->name,
-			       keyName, &value))
-	    {
-		ccsSetBool (setting, (value != 0));
-		status = TRUE;
-	    }
-	}
+	ccsSetBool (setting, iniStringToBool (retValue));
 	break;
     case TypeFloat:
-	{
-	    float value;
-	    if (ccsIniGetFloat (d, setting->parent->name,
-				keyName, &value))
-	    {
-		ccsSetFloat (setting, value);
-		status = TRUE;
-	    }
-	}
+	ccsSetFloat (setting, (float) strtod (retValue, NULL));
 	break;
     case TypeColor:
 	{
 	    CCSSettingColorValue color;
 
-	    if (ccsIniGetColor (d, setting->parent->name,
-				keyName, &color))
-	    {
-		ccsSetColor (setting, color);
-		status = TRUE;
-	    }
+	    if (!ccsStringToColor (retValue, &color))
+		return FALSE;
+
+	    ccsSetColor (setting, color);
 	}
 	break;
     case TypeKey:
 	{
 	    CCSSettingKeyValue key;
-	    if (ccsIniGetKey (d, setting->parent->name,
-			      keyName, &key))
-	    {
-		ccsSetKey (setting, key);
-		status = TRUE;
-	    }
+
+	    if (!ccsStringToKeyBinding (retValue, &key))
+		return FALSE;
+
+	    ccsSetKey (setting, key);
 	}
 	break;
     case TypeButton:
 	{
 	    CCSSettingButtonValue button;
-	    if (ccsIniGetButton (d, setting->parent->name,
-				 keyName, &button))
-	    {
-		ccsSetButton (setting, button);
-		status = TRUE;
-	    }
+
+	    if (!ccsStringToButtonBinding (retValue, &button))
+		return FALSE;
+
+	    ccsSetButton (setting, button);
 	}
 	break;
     case TypeEdge:
-	{
-	    unsigned int edges;
-	    if (ccsIniGetEdge (d, setting->parent->name,
-				 keyName, &edges))
-	    {
-		ccsSetEdge (setting, edges);
-		status = TRUE;
-	    }
-	}
+	ccsSetEdge (setting, ccsStringToEdges (retValue));
 	break;
     case TypeBell:
-	{
-	    Bool bell;
-	    if (ccsIniGetBell (d, setting->parent->name,
-			       keyName, &bell))
-	    {
-		ccsSetBell (setting, bell);
-		status = TRUE;
-	    }
-	}
+	ccsSetBell (setting, iniStringToBool (retValue));
 	break;
     case TypeList:
 	{
 	    CCSSettingValueList value;
-	    if (ccsIniGetList (d, setting->parent->name,
-			       keyName, &value, setting))
-	    {
-		ccsSetList (setting, value);
-		ccsSettingValueListFree (value, TRUE);
-		status = TRUE;
-	    }
+
+	    if (!iniStringToList (retValue, &value, setting))
+		return FALSE;
+
+	    ccsSetList (setting, value);
+	    ccsSettingValueListFree (value, TRUE);
 	}
 	break;
     default:
-	break;
+	return FALSE;
     }
 
-    if (!status)
+    return TRUE;
+}
+
+void
+ccsIniReadSetting (IniDictionary *dictionary,
+		   CCSSetting    *setting)
+{
+    if (!ccsIniReadSettingValue (dictionary, setting))
     {
 	/* reset setting to default if it could not be read */
 	ccsResetToDefault (setting);
     }
+}
+
+void
+ccsIniWriteSetting (IniDictionary *dictionary,
+		    CCSSetting    *setting)
+{
+    char         *key, *string;
+    unsigned int hash;
+    Bool         allocated = TRUE;
+
+    key = getSettingIniKey (setting, &hash);
+    if (!key)
+	return;
+
+    switch (setting->type)
+    {
+    case TypeString:
+	string = setting->value->value.asString;
+	allocated = FALSE;
+	break;
+    case TypeMatch:
+	string = setting->value->value.asMatch;
+	allocated = FALSE;
+	break;
+    case TypeInt:
+	string = strdup_printf ("%d", setting->value->value.asInt);
+	break;
+    case TypeFloat:
+	string = strdup_printf ("%f", setting->value->value.asFloat);
+	break;
+    case TypeBool:
+	string = setting->value->value.asBool ? "true" : "false";
+	allocated = FALSE;
+	break;
+    case TypeColor:
+	string = ccsColorToString (&setting->value->value.asColor);
+	break;
+    case TypeKey:
+	string = ccsKeyBindingToString (&setting->value->value.asKey);
+	break;
+    case TypeButton:
+	string = ccsButtonBindingToString (&setting->value->value.asButton);
+	break;
+    case TypeEdge:
+	string = ccsEdgesToString (setting->value->value.asEdge);
+	break;
+    case TypeBell:
+	string = setting->value->value.asBell ? "true" : "false";
+	allocated = FALSE;
+	break;
+    case TypeList:
+	string = iniListToString (setting->value->value.asList,
+				  setting->info.forList.listType);
+	break;
+    default:
+	string = NULL;
+	break;
+    }
+
+    if (!string)
+	return;
+
+    iniparser_setstr_hash (dictionary, key, hash, string);
+
+    if (allocated)
+	free (string);
+}
+
+void
+ccsIniRemoveSetting (IniDictionary *dictionary,
+		     CCSSetting    *setting)
+{
+    char         *key;
+    unsigned int hash;
+
+    key = getSettingIniKey (setting, &hash);
+    if (key)
+	iniparser_unset_hash (dictionary, key, hash);
+}
+
+/* Settings of a loaded plugin are indexed by their dictionary key for
+   reading changes from the file. The index is built on the first change
+   and rebuilt if settings were added since. */
+static Bool
+buildIniKeyIndex (CCSPluginPrivate *pPrivate)
+{
+    CCSSettingList sl;
+    unsigned int   count = ccsSettingSeqLength (&pPrivate->settings);
+    unsigned int   size, mask, i, hash;
+
+    if (pPrivate->iniKeyIndex)
+	free (pPrivate->iniKeyIndex);
+
+    for (size = 64; size < 2 * count; size *= 2);
+
+    pPrivate->iniKeyIndex = calloc (size, sizeof (CCSSetting *));
+    if (!pPrivate->iniKeyIndex)
+    {
+	pPrivate->iniKeyIndexSize = 0;
+	return FALSE;
+    }
+
+    pPrivate->iniKeyIndexSize = size;
+    pPrivate->iniKeyIndexCount = count;
+    mask = size - 1;
+
+    for (sl = pPrivate->settings.head; sl; sl = sl->next)
+    {
+	if (!getSettingIniKey (sl->data, &hash))
+	    continue;
+
+	for (i = hash & mask; pPrivate->iniKeyIndex[i]; i = (i + 1) & mask);
+
+	pPrivate->iniKeyIndex[i] = sl->data;
+    }
+
+    return TRUE;
+}
+
+static CCSSetting *
+findSettingByIniKey (CCSPlugin    *plugin,
+		     const char   *key,
+		     unsigned int hash)
+{
+    CCSSettingList sl;
+    char           *settingKey;
+    unsigned int   mask, i, settingHash;
+
+    PLUGIN_PRIV (plugin);
+
+    if ((!pPrivate->iniKeyIndex ||
+	 pPrivate->iniKeyIndexCount !=
+	 ccsSettingSeqLength (&pPrivate->settings)) &&
+	!buildIniKeyIndex (pPrivate))
+    {
+	/* fall back to searching the setting list */
+	for (sl = pPrivate->settings.head; sl; sl = sl->next)
+	{
+	    settingKey = getSettingIniKey (sl->data, &settingHash);
+	    if (settingKey && !strcmp (settingKey, key))
+		return sl->data;
+	}
 
-    if (keyName)
-	free (keyName);
+	return NULL;
+    }
+
+    mask = pPrivate->iniKeyIndexSize - 1;
+
+    for (i = hash & mask; pPrivate->iniKeyIndex[i]; i = (i + 1) & mask)
+    {
+	SETTING_PRIV (pPrivate->iniKeyIndex[i]);
+
+	if (sPrivate->iniKeyHash == hash && !strcmp (sPrivate->iniKey, key))
+	    return pPrivate->iniKeyIndex[i];
+    }
+
+    return NULL;
+}
+
+/* Re-reads the setting stored under the given dictionary key, if its
+   plugin has its settings loaded already */
+static void
+readChangedEntry (CCSContext    *context,
+		  IniDictionary *dictionary,
+		  const char    *key,
+		  unsigned int  hash)
+{
+    CCSPlugin  *plugin;
+    CCSSetting *setting;
+    char       *pluginName;
+
+    /* keys are "plugin:sN_name", with the plugin name lowercased */
+    pluginName = strndup (key, strchr (key, ':') - key);
+    if (!pluginName)
+	return;
+
+    plugin = ccsFindPlugin (context, pluginName);
+    if (!plugin)
+    {
+	CCSPluginList pl;
+
+	/* plugin names with uppercase letters only match ignoring case */
+	for (pl = context->plugins; pl; pl = pl->next)
+	    if (!strcasecmp (pl->data->name, pluginName))
+		break;
+
+	plugin = pl ? pl->data : NULL;
+    }
+
+    free (pluginName);
+
+    if (!plugin)
+	return;
+
+    PLUGIN_PRIV (plugin);
+
+    /* other plugins read their settings once they get loaded */
+    if (!pPrivate->loaded)
+	return;
+
+    setting = findSettingByIniKey (plugin, key, hash);
+    if (setting)
+	ccsIniReadSetting (dictionary, setting);
+}
+
+static Bool
+iniValuesDiffer (const char *value1,
+		 const char *value2)
+{
+    if (!value1 || !value2)
+	return value1 != value2;
+
+    return strcmp (value1, value2) != 0;
+}
+
+/* Reads the settings whose entries differ between an old and a new
+   version of the same dictionary from the new one */
+void
+ccsIniReadChangedSettings (CCSContext    *context,
+			   IniDictionary *oldDictionary,
+			   IniDictionary *newDictionary)
+{
+    int  section, entry;
+    char *value, *otherValue;
+
+    /* added or modified entries */
+    for (section = iniparser_next_section (newDictionary, -1, NULL);
+	 section >= 0;
+	 section = iniparser_next_section (newDictionary, section, NULL))
+    {
+	for (entry = iniparser_next_entry (newDictionary, section, -1,
+					   NULL, &value);
+	     entry >= 0;
+	     entry = iniparser_next_entry (newDictionary, section, entry,
+					   NULL, &value))
+	{
+	    otherValue =
+		iniparser_getstring_hash (oldDictionary,
+					  newDictionary->key[entry],
+					  newDictionary->hash[entry], NULL);
+
+	    if (iniValuesDiffer (value, otherValue))
+		readChangedEntry (context, newDictionary,
+				  newDictionary->key[entry],
+				  newDictionary->hash[entry]);
+	}
+    }
+
+    /* removed entries */
+    for (section = iniparser_next_section (oldDictionary, -1, NULL);
+	 section >= 0;
+	 section = iniparser_next_section (oldDictionary, section, NULL))
+    {
+	for (entry = iniparser_next_entry (oldDictionary, section, -1,
+					   NULL, &value);
+	     entry >= 0;
+	     entry = iniparser_next_entry (oldDictionary, section, entry,
+					   NULL, &value))
+	{
+	    if (!value)
+		continue;
+
+	    otherValue =
+		iniparser_getstring_hash (newDictionary,
+					  oldDictionary->key[entry],
+					  oldDictionary->hash[entry], NULL);
+
+	    if (!otherValue)
+		readChangedEntry (context, newDictionary,
+				  oldDictionary->key[entry],
+				  oldDictionary->hash[entry]);
+	}
+    }
+}
+
+void
+ccsIniIteratorInit (IniDictionary *dictionary,
+		    IniIterator   *iterator)
+{
+    iterator->dictionary = dictionary;
+    iterator->section    = -1;
+    iterator->entry      = -1;
+}
+
+Bool
+ccsIniIteratorNextSection (IniIterator *iterator,
+			   const char  **section)
+{
+    char *name;
+
+    /* Keep returning FALSE instead of restarting from the first one */
+    if (iterator->section < -1)
+	return FALSE;
+
+    iterator->section = iniparser_next_section (iterator->dictionary,
+						iterator->section, &name);
+    iterator->entry = -1;
+
+    if (iterator->section < 0)
+    {
+	iterator->section = -2;
+	return FALSE;
+    }
+
+    if (section)
+	*section = name;
+
+    return TRUE;
+}
+
+Bool
+ccsIniIteratorNextEntry (IniIterator *iterator,
+			 const char  **entry,
+			 const char  **value)
+{
+    char *key, *val;
+
+    iterator->entry = iniparser_next_entry (iterator->dictionary,
+					    iterator->section,
+					    iterator->entry, &key, &val);
+    if (iterator->entry < 0)
+	return FALSE;
+
+    if (entry)
+	*entry = key;
+    if (value)
+	*value = val;
+
+    return TRUE;
 }
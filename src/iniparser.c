@@ -32,11 +32,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 
 #include "iniparser.h"
 
@@ -46,33 +48,31 @@ extern "C"
 {
 #endif
 
-/* lock INI file access against concurrent access */
+/* lock INI file access against writers which rewrite the file in place;
+   files saved by iniparser_dump_ini are replaced atomically instead */
 
 static FileLock*
-ini_file_lock (const char *fileName, Bool exclusive)
+ini_file_lock (const char *fileName)
 {
     int          fd;
     FileLock     *lock;
     struct flock lockinfo;
 
-    if (exclusive)
-	fd = open (fileName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-    else
-	fd = open (fileName, O_RDONLY | O_CREAT, 0666);
+    fd = open (fileName, O_RDONLY | O_CREAT, 0666);
     if (fd < 0)
 	return NULL;
 
     lock = malloc (sizeof (FileLock));
     if (!lock)
+    {
+	close (fd);
 	return NULL;
+    }
 
     lock->fd = fd;
     memset (&lockinfo, 0, sizeof (struct flock));
 
-    if (exclusive)
-	lockinfo.l_type = F_WRLCK;
-    else
-	lockinfo.l_type = F_RDLCK;
+    lockinfo.l_type = F_RDLCK;
     lockinfo.l_pid = getpid();
     fcntl (fd, F_SETLKW, &lockinfo);
 
@@ -131,79 +131,79 @@ strlwc (char * s)
     return l;
 }
 
-/*-------------------------------------------------------------------------*/
-/**
-  @brief    Skip blanks until the first non-blank character.
-  @param    s   String to parse.
-  @return   Pointer to char inside given string.
+/* dictionary.c.c following */
 
-  This function returns a pointer to the first non-blank character in the
-  given string.
-  */
-/*--------------------------------------------------------------------------*/
-static char*
-strskp (char * s)
-{
-    char * skip = s;
+/** Maximum value size for integers and doubles. */
+#define MAXVALSZ    1024
 
-    if (!s)
-	return NULL;
+/** Minimal allocated number of entries in a dictionary */
+#define DICTMINSZ   128
 
-    while (isspace ((int) *skip) && *skip)
-	skip++;
+/** Invalid key token */
+#define DICT_INVALID_KEY    ((char*)-1)
 
-    return skip;
-}
+/** Minimal size of a string storage chunk */
+#define DICTCHUNKSZ 16384
 
-/*-------------------------------------------------------------------------*/
-/**
-  @brief    Remove blanks at the end of a string.
-  @param    s   String to parse.
-  @return   ptr to statically allocated string.
+/** Index table cell markers */
+#define DICT_CELL_EMPTY     0
+#define DICT_CELL_DELETED   -1
 
-  This function returns a pointer to a statically allocated string,
-  which is identical to the input string, except that all blank
-  characters at the end of the string have been removed.
-  Do not free or modify the returned string! Since the returned string
-  is statically allocated, it will be modified at each function call
-  (not re-entrant).
-  */
-/*--------------------------------------------------------------------------*/
-static char*
-strcrop (char * s)
+/*
+   A section of a dictionary. Sections are kept in creation order, and
+   the entries of each section are chained in insertion order through
+   the per-slot next/prev links of the dictionary.
+   */
+typedef struct _DictionarySection
 {
-    static char l[ASCIILINESZ+1];
-    char        *last;
-
-    if (!s)
-	return NULL;
+    int  key;		/* slot of the section key, -1 if it was removed */
+    char *name;		/* copy of the name while the section key is gone */
+    int  first;		/* first entry slot, -1 if empty */
+    int  last;		/* last entry slot, -1 if empty */
+} DictionarySection;
 
-    memset (l, 0, ASCIILINESZ + 1);
-    strcpy (l, s);
-
-    last = l + strlen (l);
-    while (last > l)
-    {
-	if (!isspace ((int) * (last - 1)))
-	    break;
-
-    	last --;
-    }
+/*
+   A block of string storage. Keys and values of a dictionary are carved
+   out of a list of chunks, which are only released all at once.
+   */
+typedef struct _DictionaryChunk
+{
+    struct _DictionaryChunk *next;
+    size_t                  size;
+    size_t                  used;
+    char                    data[1];
+} DictionaryChunk;
 
-    *last = (char) 0;
-    return l;
-}
+/*
+   Lookup index of a dictionary. Every cell of the open addressing table
+   holds the slot number + 1 of the key it refers to, DICT_CELL_EMPTY or
+   DICT_CELL_DELETED. The table is always at least twice as large as the
+   slot arrays, so probing sequences stay short.
+   */
+typedef struct _DictionaryPrivate
+{
+    int *table;
+    int tableSize;
+    int tableUsed;	/* non-empty cells, including deleted ones */
+    int freeSlot;	/* no slot below this one is free */
 
-/* dictionary.c.c following */
+    int *owner;		/* section of each slot */
+    int *next;		/* next entry slot of the same section */
+    int *prev;		/* previous entry slot of the same section */
+    int *valSize;	/* storage reserved for the value of each slot */
 
-/** Maximum value size for integers and doubles. */
-#define MAXVALSZ    1024
+    DictionaryChunk *chunks;	/* string storage, current chunk first */
+    size_t          live;	/* bytes used by current keys and values */
+    size_t          wasted;	/* bytes left behind by replaced strings */
 
-/** Minimal allocated number of entries in a dictionary */
-#define DICTMINSZ   128
+    DictionarySection *sections;
+    int               nSections;
+    int               sectionsSize;
+    int               activeSections;	/* sections with a section key */
+} DictionaryPrivate;
 
-/** Invalid key token */
-#define DICT_INVALID_KEY    ((char*)-1)
+#define DICT_PRIV(d) \
+    DictionaryPrivate *dPrivate = (DictionaryPrivate *) (d)->ccsPrivate;
 
 /*
    Doubles the allocated size associated to a pointer
@@ -214,12 +214,11 @@ mem_double (void * ptr, int size)
 {
     void *newptr;
 
-    newptr = calloc (2 * size, 1);
+    newptr = realloc (ptr, 2 * size);
     if (!newptr)
 	return NULL;
 
-    memcpy (newptr, ptr, size);
-    free (ptr);
+    memset ((char *) newptr + size, 0, size);
     return newptr;
 }
 
@@ -261,6 +260,418 @@ static unsigned dictionary_hash (char * key)
     return hash;
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Copy a string into the storage of a dictionary.
+  @param    d       dictionary object owning the storage.
+  @param    s       String to copy.
+  @param    len     Length of the string, without the terminating null.
+  @return   Pointer to the copy, NULL if out of memory.
+
+  The copy is released together with the dictionary, it must not be
+  freed on its own.
+  */
+/*--------------------------------------------------------------------------*/
+static char*
+dictionary_strdup (dictionary * d, const char * s, size_t len)
+{
+    DictionaryChunk *chunk;
+    char            *copy;
+
+    DICT_PRIV (d);
+
+    chunk = dPrivate->chunks;
+    if (!chunk || chunk->size - chunk->used < len + 1)
+    {
+	size_t size = len + 1 > DICTCHUNKSZ ? len + 1 : DICTCHUNKSZ;
+
+	chunk = (DictionaryChunk *) malloc (sizeof (DictionaryChunk) + size);
+	if (!chunk)
+	    return NULL;
+
+	chunk->size = size;
+	chunk->used = 0;
+
+	/* Oversized strings get a chunk of their own, so the free space
+	   of the current chunk can still be used */
+	if (size > DICTCHUNKSZ && dPrivate->chunks)
+	{
+	    chunk->next = dPrivate->chunks->next;
+	    dPrivate->chunks->next = chunk;
+	}
+	else
+	{
+	    chunk->next = dPrivate->chunks;
+	    dPrivate->chunks = chunk;
+	}
+    }
+
+    copy = chunk->data + chunk->used;
+    chunk->used += len + 1;
+    dPrivate->live += len + 1;
+
+    memcpy (copy, s, len);
+    copy[len] = (char) 0;
+
+    return copy;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Repack the string storage of a dictionary.
+  @param    d   dictionary object to repack.
+  @return   void
+
+  Once strings left behind by replaced values and deleted keys take more
+  room than the current ones, all keys and values are copied into fresh
+  chunks and the old chunks are released. This moves every key and value,
+  so no pointer previously returned for the dictionary may be in use.
+  Modifications never repack on their own, the owner of a long-lived
+  dictionary calls this at a point where it holds no such pointers.
+  */
+/*--------------------------------------------------------------------------*/
+void
+iniparser_compact (dictionary * d)
+{
+    DictionaryChunk *chunk, *old, *next;
+    size_t          size = 0;
+    int             i;
+
+    DICT_PRIV (d);
+
+    if (dPrivate->wasted < DICTCHUNKSZ || dPrivate->wasted < dPrivate->live)
+	return;
+
+    /* All strings go into a single chunk allocated up front, so copying
+       them cannot fail halfway. Without it the old storage is kept. */
+    for (i = 0; i < d->size; i++)
+    {
+	if (!d->key[i])
+	    continue;
+
+	size += strlen (d->key[i]) + 1;
+	if (d->val[i])
+	    size += strlen (d->val[i]) + 1;
+    }
+
+    if (size < DICTCHUNKSZ)
+	size = DICTCHUNKSZ;
+
+    chunk = (DictionaryChunk *) malloc (sizeof (DictionaryChunk) + size);
+    if (!chunk)
+	return;
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+
+    old = dPrivate->chunks;
+
+    dPrivate->chunks = chunk;
+    dPrivate->live   = 0;
+    dPrivate->wasted = 0;
+
+    for (i = 0; i < d->size; i++)
+    {
+	if (!d->key[i])
+	    continue;
+
+	d->key[i] = dictionary_strdup (d, d->key[i], strlen (d->key[i]));
+
+	if (d->val[i])
+	{
+	    size_t len = strlen (d->val[i]);
+
+	    d->val[i] = dictionary_strdup (d, d->val[i], len);
+	    dPrivate->valSize[i] = len + 1;
+	}
+    }
+
+    for (; old; old = next)
+    {
+	next = old->next;
+	free (old);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    (Re)build the lookup index of a dictionary.
+  @param    d           dictionary object to index.
+  @param    tableSize   Number of index cells, must be a power of two.
+  @return   int 0 if Ok, -1 otherwise.
+
+  Allocates a fresh index table and inserts all keys currently stored
+  in the dictionary, dropping any deleted cells of the old table.
+  */
+/*--------------------------------------------------------------------------*/
+static int
+dictionary_reindex (dictionary * d, int tableSize)
+{
+    int *table;
+    int i, cell, mask;
+
+    DICT_PRIV (d);
+
+    table = (int *) calloc (tableSize, sizeof (int));
+    if (!table)
+	return -1;
+
+    mask = tableSize - 1;
+
+    for (i = 0; i < d->size; i++)
+    {
+	if (!d->key[i])
+	    continue;
+
+	cell = d->hash[i] & mask;
+	while (table[cell] != DICT_CELL_EMPTY)
+	    cell = (cell + 1) & mask;
+
+	table[cell] = i + 1;
+    }
+
+    free (dPrivate->table);
+
+    dPrivate->table     = table;
+    dPrivate->tableSize = tableSize;
+    dPrivate->tableUsed = d->n;
+
+    return 0;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Locate a key in the lookup index of a dictionary.
+  @param    d       dictionary object to search.
+  @param    key     Key to look for in the dictionary.
+  @param    hash    Precomputed hash of the key.
+  @param    insert  If non-NULL, receives the cell a new key should use.
+  @return   Index table cell holding the key, or -1 if not found.
+  */
+/*--------------------------------------------------------------------------*/
+static int
+dictionary_lookup (dictionary * d, char * key, unsigned hash, int * insert)
+{
+    int cell, slot, mask;
+
+    DICT_PRIV (d);
+
+    mask = dPrivate->tableSize - 1;
+    cell = hash & mask;
+
+    if (insert)
+	*insert = -1;
+
+    while (dPrivate->table[cell] != DICT_CELL_EMPTY)
+    {
+	slot = dPrivate->table[cell] - 1;
+
+	if (slot < 0)
+	{
+	    if (insert && *insert < 0)
+		*insert = cell;
+	}
+	/* Compare hash, then string to avoid hash collisions */
+	else if (hash == d->hash[slot] && !strcmp (key, d->key[slot]))
+	    return cell;
+
+	cell = (cell + 1) & mask;
+    }
+
+    if (insert && *insert < 0)
+	*insert = cell;
+
+    return -1;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Make room for one more section.
+  @param    d       dictionary object to modify.
+  @return   int 0 if Ok, -1 otherwise.
+
+  Called before a section key is stored, so registering it afterwards
+  cannot fail.
+  */
+/*--------------------------------------------------------------------------*/
+static int
+dictionary_reserve_section (dictionary * d)
+{
+    DictionarySection *sections;
+    int               newSize;
+
+    DICT_PRIV (d);
+
+    if (dPrivate->nSections < dPrivate->sectionsSize)
+	return 0;
+
+    newSize = dPrivate->sectionsSize ? 2 * dPrivate->sectionsSize : 16;
+
+    sections = (DictionarySection *) realloc (dPrivate->sections,
+					      newSize * sizeof (*sections));
+    if (!sections)
+	return -1;
+
+    dPrivate->sections     = sections;
+    dPrivate->sectionsSize = newSize;
+
+    return 0;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Register the section key stored in a slot.
+  @param    d       dictionary object to modify.
+  @param    slot    Slot holding the new section key.
+  @return   void
+
+  If a section of that name lost its section key earlier, its entries
+  are attached to the key again, otherwise a new empty section is
+  appended to the section list, which dictionary_reserve_section must
+  have made room for.
+  */
+/*--------------------------------------------------------------------------*/
+static void
+dictionary_add_section (dictionary * d, int slot)
+{
+    DictionarySection *sec = NULL;
+    int               i;
+
+    DICT_PRIV (d);
+
+    for (i = 0; i < dPrivate->nSections; i++)
+    {
+	sec = &dPrivate->sections[i];
+
+	if (sec->key < 0 && sec->name && !strcmp (sec->name, d->key[slot]))
+	{
+	    free (sec->name);
+	    sec->name = NULL;
+	    break;
+	}
+    }
+
+    if (i == dPrivate->nSections)
+    {
+	sec = &dPrivate->sections[dPrivate->nSections++];
+	sec->name  = NULL;
+	sec->first = -1;
+	sec->last  = -1;
+    }
+
+    sec->key = slot;
+    dPrivate->owner[slot] = i;
+    dPrivate->activeSections++;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Double the number of slots of a dictionary.
+  @param    d       dictionary object to grow.
+  @return   int 0 if Ok, -1 otherwise.
+
+  The slot arrays and the lookup index are all enlarged before d->size
+  changes, so the dictionary stays usable at its old size on failure.
+  Arrays that did grow keep their contents and are simply larger than
+  needed.
+  */
+/*--------------------------------------------------------------------------*/
+static int
+dictionary_grow (dictionary * d)
+{
+    void *ptr;
+
+    DICT_PRIV (d);
+
+    ptr = mem_double (d->val, d->size * sizeof (char *));
+    if (!ptr)
+	return -1;
+    d->val = (char **) ptr;
+
+    ptr = mem_double (d->key, d->size * sizeof (char *));
+    if (!ptr)
+	return -1;
+    d->key = (char **) ptr;
+
+    ptr = mem_double (d->hash, d->size * sizeof (unsigned));
+    if (!ptr)
+	return -1;
+    d->hash = (unsigned int *) ptr;
+
+    ptr = mem_double (dPrivate->owner, d->size * sizeof (int));
+    if (!ptr)
+	return -1;
+    dPrivate->owner = (int *) ptr;
+
+    ptr = mem_double (dPrivate->next, d->size * sizeof (int));
+    if (!ptr)
+	return -1;
+    dPrivate->next = (int *) ptr;
+
+    ptr = mem_double (dPrivate->prev, d->size * sizeof (int));
+    if (!ptr)
+	return -1;
+    dPrivate->prev = (int *) ptr;
+
+    ptr = mem_double (dPrivate->valSize, d->size * sizeof (int));
+    if (!ptr)
+	return -1;
+    dPrivate->valSize = (int *) ptr;
+
+    /* The new slots are still empty, so indexing the old ones suffices */
+    if (dictionary_reindex (d, 2 * dPrivate->tableSize) < 0)
+	return -1;
+
+    /* Double size */
+    d->size *= 2;
+
+    return 0;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the section an entry key belongs to.
+  @param    d       dictionary object to modify.
+  @param    key     Entry key, as "section:keyword".
+  @return   Index of the section, -1 in case of error.
+
+  The section key is created if the dictionary does not contain it yet,
+  so every entry can be written back below a section header.
+  */
+/*--------------------------------------------------------------------------*/
+static void dictionary_set (dictionary * d, char * key, unsigned hash,
+			    char * val);
+
+static int
+dictionary_entry_section (dictionary * d, char * key)
+{
+    char     *name;
+    unsigned hash;
+    int      cell;
+
+    DICT_PRIV (d);
+
+    name = strndup (key, strchr (key, ':') - key);
+    if (!name)
+	return -1;
+
+    hash = dictionary_hash (name);
+    cell = dictionary_lookup (d, name, hash, NULL);
+    if (cell < 0)
+    {
+	dictionary_set (d, name, hash, NULL);
+	cell = dictionary_lookup (d, name, hash, NULL);
+    }
+
+    free (name);
+
+    if (cell < 0)
+	return -1;
+
+    return dPrivate->owner[dPrivate->table[cell] - 1];
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Create a new dictionary object.
@@ -275,7 +686,9 @@ static unsigned dictionary_hash (char * key)
 dictionary*
 dictionary_new (int size)
 {
-    dictionary *d;
+    dictionary        *d;
+    DictionaryPrivate *dPrivate;
+    int               tableSize;
 
     /* If no size was specified, allocate space for DICTMINSZ */
     if (size < DICTMINSZ)
@@ -285,27 +698,39 @@ dictionary_new (int size)
     if (!d)
 	return NULL;
 
-    d->size = size;
-    d->val  = (char **) calloc (size, sizeof (char*));
-    if (!d->val)
+    dPrivate = (DictionaryPrivate *) calloc (1, sizeof (DictionaryPrivate));
+    if (!dPrivate)
     {
 	free (d);
 	return NULL;
     }
 
-    d->key  = (char **) calloc (size, sizeof (char*));
-    if (!d->key)
-    {
-	free (d->val);
-	free (d);
-	return NULL;
-    }
+    d->ccsPrivate = dPrivate;
 
+    d->size = size;
+    d->val  = (char **) calloc (size, sizeof (char*));
+    d->key  = (char **) calloc (size, sizeof (char*));
     d->hash = (unsigned int *) calloc (size, sizeof (unsigned));
-    if (!d->hash)
+
+    dPrivate->owner = (int *) calloc (size, sizeof (int));
+    dPrivate->next  = (int *) calloc (size, sizeof (int));
+    dPrivate->prev  = (int *) calloc (size, sizeof (int));
+    dPrivate->valSize = (int *) calloc (size, sizeof (int));
+
+    for (tableSize = 1; tableSize < 2 * size; tableSize <<= 1);
+
+    if (!d->val || !d->key || !d->hash ||
+	!dPrivate->owner || !dPrivate->next || !dPrivate->prev ||
+	!dPrivate->valSize || dictionary_reindex (d, tableSize) < 0)
     {
+	free (dPrivate->valSize);
+	free (dPrivate->prev);
+	free (dPrivate->next);
+	free (dPrivate->owner);
+	free (d->hash);
 	free (d->key);
 	free (d->val);
+	free (dPrivate);
 	free (d);
 	return NULL;
     }
@@ -325,23 +750,35 @@ dictionary_new (int size)
 static void
 dictionary_del (dictionary * d)
 {
-    int     i;
+    DictionaryChunk *chunk, *next;
+    int             i;
 
     if (!d)
 	return;
 
-    for (i = 0; i < d->size; i++)
-    {
-	if (d->key[i])
-	    free (d->key[i]);
+    DICT_PRIV (d);
 
-	if (d->val[i])
-	    free (d->val[i]);
+    for (chunk = dPrivate->chunks; chunk; chunk = next)
+    {
+	next = chunk->next;
+	free (chunk);
     }
 
     free (d->val);
     free (d->key);
     free (d->hash);
+
+    for (i = 0; i < dPrivate->nSections; i++)
+	if (dPrivate->sections[i].name)
+	    free (dPrivate->sections[i].name);
+
+    free (dPrivate->sections);
+    free (dPrivate->valSize);
+    free (dPrivate->prev);
+    free (dPrivate->next);
+    free (dPrivate->owner);
+    free (dPrivate->table);
+    free (dPrivate);
     free (d);
 
     return;
@@ -352,6 +789,7 @@ dictionary_del (dictionary * d)
   @brief    Get a value from a dictionary.
   @param    d       dictionary object to search.
   @param    key     Key to look for in the dictionary.
+  @param    hash    Hash of the key, as computed by dictionary_hash.
   @param    def     Default value to return if key not found.
   @return   1 pointer to internally allocated character string.
 
@@ -362,30 +800,17 @@ dictionary_del (dictionary * d)
   */
 /*--------------------------------------------------------------------------*/
 static char*
-dictionary_get (dictionary * d, char * key, char * def)
+dictionary_get (dictionary * d, char * key, unsigned hash, char * def)
 {
-    unsigned    hash;
-    int         i;
-
-    hash = dictionary_hash (key);
+    int cell;
 
-    for (i = 0; i < d->size; i++)
-    {
-	if (!d->key)
-    	    continue;
+    DICT_PRIV (d);
 
-	/* Compare hash */
-	if (hash == d->hash[i])
-	{
-	    /* Compare string, to avoid hash collisions */
-	    if (!strcmp (key, d->key[i]))
-	    {
-		return d->val[i];
-	    }
-	}
-    }
+    cell = dictionary_lookup (d, key, hash, NULL);
+    if (cell < 0)
+	return def;
 
-    return def;
+    return d->val[dPrivate->table[cell] - 1];
 }
 
 
@@ -394,6 +819,7 @@ dictionary_get (dictionary * d, char * key, char * def)
   @brief    Set a value in a dictionary.
   @param    d       dictionary object to modify.
   @param    key     Key to modify or add.
+  @param    hash    Hash of the key, as computed by dictionary_hash.
   @param    val     Value to add.
   @return   void
 
@@ -414,59 +840,86 @@ dictionary_get (dictionary * d, char * key, char * def)
   */
 /*--------------------------------------------------------------------------*/
 static void
-dictionary_set (dictionary * d, char * key, char * val)
+dictionary_set (dictionary * d, char * key, unsigned hash, char * val)
 {
-    int         i;
-    unsigned    hash;
+    int         i, cell, insert, section;
+    size_t      len;
+    DictionarySection *sec;
 
     if (!d || !key)
 	return;
 
-    /* Compute hash for this key */
-    hash = dictionary_hash (key);
+    DICT_PRIV (d);
 
     /* Find if value is already in blackboard */
-    if (d->n > 0)
+    cell = dictionary_lookup (d, key, hash, &insert);
+    if (cell >= 0)
     {
-	for (i = 0; i < d->size; i++)
-	{
-	    if (!d->key[i])
-		continue;
+	/* Found a value: modify and return */
+	i = dPrivate->table[cell] - 1;
+	len = val ? strlen (val) : 0;
 
-	    if (hash == d->hash[i])
-    	    {
-		/* Same hash value */
-	    	if (!strcmp (key, d->key[i]))
-		{
-		    /* Same key */
-		    /* Found a value: modify and return */
-		    if (d->val[i])
-			free (d->val[i]);
-
-		    d->val[i] = val ? strdup (val) : NULL;
-		    /* Value has been modified: return */
-		    return;
-		}
-	    }
+	if (val && len < (size_t) dPrivate->valSize[i])
+	{
+	    /* Reuse the storage of the old value */
+	    memmove (d->val[i], val, len + 1);
+	    return;
 	}
+
+	dPrivate->live   -= dPrivate->valSize[i];
+	dPrivate->wasted += dPrivate->valSize[i];
+
+	d->val[i] = val ? dictionary_strdup (d, val, len) : NULL;
+	dPrivate->valSize[i] = d->val[i] ? len + 1 : 0;
+
+	/* Value has been modified: return */
+	return;
     }
 
     /* Add a new value */
+    /* A section without a name could not be written back as a header */
+    if (!*key || *key == ':')
+	return;
+
+    /* Entries are chained to their section, which may need to be added */
+    if (strchr (key, ':'))
+    {
+	section = dictionary_entry_section (d, key);
+	if (section < 0)
+	    return;
+
+	dictionary_lookup (d, key, hash, &insert);
+    }
+    else
+    {
+	if (dictionary_reserve_section (d) < 0)
+	    return;
+
+	section = -1;
+    }
+
     /* See if dictionary needs to grow */
     if (d->n == d->size)
     {
 	/* Reached maximum size: reallocate blackboard */
-	d->val  = (char **) mem_double (d->val,  d->size * sizeof (char*));
-	d->key  = (char **) mem_double (d->key,  d->size * sizeof (char*));
-	d->hash = (unsigned int *) mem_double (d->hash,
-					       d->size * sizeof (unsigned));
+	if (dictionary_grow (d) < 0)
+	    return;
 
-	/* Double size */
-	d->size *= 2;
+	dictionary_lookup (d, key, hash, &insert);
+    }
+    else if (dPrivate->table[insert] == DICT_CELL_EMPTY &&
+	     (dPrivate->tableUsed + 1) * 4 > dPrivate->tableSize * 3)
+    {
+	/* Too many deleted cells: drop them before they slow down probing,
+	   the table must not run full */
+	if (dictionary_reindex (d, dPrivate->tableSize) < 0)
+	    return;
+
+	dictionary_lookup (d, key, hash, &insert);
     }
 
     /* Insert key in the first empty slot */
-    for (i = 0; i < d->size; i++)
+    for (i = dPrivate->freeSlot; i < d->size; i++)
     {
 	if (!d->key[i])
 	{
@@ -475,11 +928,43 @@ dictionary_set (dictionary * d, char * key, char * val)
 	}
     }
 
-    /* Copy key */
-    d->key[i]  = strdup (key);
-    d->val[i]  = val ? strdup (val) : NULL;
-    d->hash[i] = hash;
-    d->n++;
+    /* Copy key */
+    len = val ? strlen (val) : 0;
+
+    d->key[i]  = dictionary_strdup (d, key, strlen (key));
+    d->val[i]  = val ? dictionary_strdup (d, val, len) : NULL;
+    d->hash[i] = hash;
+
+    if (!d->key[i])
+	return;
+
+    dPrivate->valSize[i] = d->val[i] ? len + 1 : 0;
+    d->n++;
+
+    if (dPrivate->table[insert] == DICT_CELL_EMPTY)
+	dPrivate->tableUsed++;
+
+    dPrivate->table[insert] = i + 1;
+    dPrivate->freeSlot = i + 1;
+
+    if (section < 0)
+    {
+	dictionary_add_section (d, i);
+	return;
+    }
+
+    sec = &dPrivate->sections[section];
+
+    dPrivate->owner[i] = section;
+    dPrivate->next[i]  = -1;
+    dPrivate->prev[i]  = sec->last;
+
+    if (sec->last >= 0)
+	dPrivate->next[sec->last] = i;
+    else
+	sec->first = i;
+
+    sec->last = i;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -487,6 +972,7 @@ dictionary_set (dictionary * d, char * key, char * val)
   @brief    Delete a key in a dictionary
   @param    d       dictionary object to modify.
   @param    key     Key to remove.
+  @param    hash    Hash of the key, as computed by dictionary_hash.
   @return   void
 
   This function deletes a key in a dictionary. Nothing is done if the
@@ -494,42 +980,54 @@ dictionary_set (dictionary * d, char * key, char * val)
   */
 /*--------------------------------------------------------------------------*/
 static void
-dictionary_unset (dictionary * d, char * key)
+dictionary_unset (dictionary * d, char * key, unsigned hash)
 {
-    unsigned    hash;
-    int         i;
+    int         i, cell;
+    size_t      len;
+    DictionarySection *sec;
 
-    hash = dictionary_hash (key);
+    DICT_PRIV (d);
 
-    for (i = 0; i < d->size; i++)
+    cell = dictionary_lookup (d, key, hash, NULL);
+    if (cell < 0)
+	/* Key not found */
+	return;
+
+    i = dPrivate->table[cell] - 1;
+    dPrivate->table[cell] = DICT_CELL_DELETED;
+
+    sec = &dPrivate->sections[dPrivate->owner[i]];
+    if (sec->key == i)
     {
-	if (!d->key[i])
-	    continue;
+	/* Section key: keep its entries around in case it comes back */
+	sec->key  = -1;
+	sec->name = strdup (d->key[i]);
+	dPrivate->activeSections--;
+    }
+    else
+    {
+	/* Entry: unlink it from its section */
+	if (dPrivate->prev[i] >= 0)
+	    dPrivate->next[dPrivate->prev[i]] = dPrivate->next[i];
+	else
+	    sec->first = dPrivate->next[i];
 
-	/* Compare hash */
-	if (hash == d->hash[i])
-      	{
-	    /* Compare string, to avoid hash collisions */
-	    if (!strcmp (key, d->key[i]))
-	    {
-		/* Found key */
-		break;
-	    }
-	}
+	if (dPrivate->next[i] >= 0)
+	    dPrivate->prev[dPrivate->next[i]] = dPrivate->prev[i];
+	else
+	    sec->last = dPrivate->prev[i];
     }
 
-    if (i >= d->size)
-	/* Key not found */
-	return;
+    if (i < dPrivate->freeSlot)
+	dPrivate->freeSlot = i;
 
-    free (d->key[i]);
+    len = strlen (d->key[i]) + 1 + dPrivate->valSize[i];
+    dPrivate->live   -= len;
+    dPrivate->wasted += len;
 
     d->key[i] = NULL;
-    if (d->val[i])
-    {
-	free (d->val[i]);
-	d->val[i] = NULL;
-    }
+    d->val[i] = NULL;
+    dPrivate->valSize[i] = 0;
 
     d->hash[i] = 0;
     d->n --;
@@ -555,8 +1053,9 @@ iniparser_add_entry (dictionary * d,
     else
 	strcpy (longkey, sec);
 
-    /* Add (key,val) to dictionary */
-    dictionary_set (d, longkey, val);
+    /* Add (key,val) to dictionary, keys are looked up in lowercase */
+    strcpy (longkey, strlwc (longkey));
+    dictionary_set (d, longkey, dictionary_hash (longkey), val);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -580,23 +1079,102 @@ iniparser_add_entry (dictionary * d,
 int
 iniparser_getnsec (dictionary * d)
 {
-    int i;
-    int nsec;
+    if (!d)
+	return -1;
+
+    DICT_PRIV (d);
 
+    return dPrivate->activeSections;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the next section of a dictionary.
+  @param    d       Dictionary to examine
+  @param    section Previous section index, -1 to get the first one.
+  @param    name    If non-NULL, receives the section name.
+  @return   Index of the next section, -1 if there is none.
+
+  Sections are returned in the order they were added to the dictionary.
+  The name points to a string allocated inside the dictionary, do not
+  free or modify it.
+  */
+/*--------------------------------------------------------------------------*/
+int
+iniparser_next_section (dictionary * d, int section, char ** name)
+{
     if (!d)
 	return -1;
 
-    nsec = 0;
-    for (i = 0; i < d->size; i++)
+    DICT_PRIV (d);
+
+    for (section++; section < dPrivate->nSections; section++)
     {
-	if (!d->key[i])
+	if (dPrivate->sections[section].key < 0)
 	    continue;
 
-	if (!strchr (d->key[i], ':'))
-    	    nsec++;
+	if (name)
+	    *name = d->key[dPrivate->sections[section].key];
+
+	return section;
     }
 
-    return nsec;
+    return -1;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the next entry of a section.
+  @param    d       Dictionary to examine
+  @param    section Section index, as returned by iniparser_next_section.
+  @param    entry   Previous entry index, -1 to get the first one.
+  @param    key     If non-NULL, receives the key without section prefix.
+  @param    val     If non-NULL, receives the value.
+  @return   Index of the next entry, -1 if there is none.
+
+  Entries are returned in the order they were added to the section.
+  The returned index is the slot of the entry in the key, val and hash
+  arrays of the dictionary.
+  Removing the returned entry ends the iteration. Both strings are
+  allocated inside the dictionary, do not free or modify them.
+  */
+/*--------------------------------------------------------------------------*/
+int
+iniparser_next_entry (dictionary * d,
+		      int          section,
+		      int          entry,
+		      char **      key,
+		      char **      val)
+{
+    DictionarySection *sec;
+
+    if (!d || section < 0)
+	return -1;
+
+    DICT_PRIV (d);
+
+    if (section >= dPrivate->nSections)
+	return -1;
+
+    sec = &dPrivate->sections[section];
+
+    if (entry < 0)
+	entry = sec->first;
+    else if (entry < d->size && d->key[entry] &&
+	     dPrivate->owner[entry] == section && entry != sec->key)
+	entry = dPrivate->next[entry];
+    else
+	entry = -1;
+
+    if (entry < 0)
+	return -1;
+
+    if (key)
+	*key = strchr (d->key[entry], ':') + 1;
+    if (val)
+	*val = d->val[entry];
+
+    return entry;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -616,70 +1194,162 @@ iniparser_getnsec (dictionary * d)
 char*
 iniparser_getsecname (dictionary * d, int n)
 {
-    int i;
-    int foundsec;
+    int  section;
+    char *name;
 
     if (!d || n < 0)
 	return NULL;
 
-    foundsec = 0;
-    for (i = 0; i < d->size; i++)
-    {
-	if (!d->key[i])
-	    continue;
+    section = iniparser_next_section (d, -1, &name);
+    while (section >= 0 && n--)
+	section = iniparser_next_section (d, section, &name);
+
+    if (section < 0)
+	return NULL;
+
+    return name;
+}
+
+/* whether saved files are flushed to disk before they replace the old one */
+static Bool iniSyncOnSave = TRUE;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set whether saved ini files are synced to disk
+  @param    sync    TRUE to fsync files before they are renamed into place
+  @return   void
+
+  Syncing guarantees that a crash right after iniparser_dump_ini() leaves
+  either the old or the new file on disk, at the cost of a disk flush per
+  save.
+  */
+/*--------------------------------------------------------------------------*/
+void
+iniparser_set_sync (Bool sync)
+{
+    iniSyncOnSave = sync;
+}
 
-	if (!strchr (d->key[i], ':'))
+/* create a temporary file next to fileName, with the permissions of
+   fileName if it exists and the default permissions otherwise */
+
+static int
+ini_create_temp (const char *fileName, char **tempName)
+{
+    struct stat st;
+    char        *name;
+    int         fd, i;
+    size_t      len;
+
+    len = strlen (fileName) + 32;
+    name = malloc (len);
+    if (!name)
+	return -1;
+
+    for (i = 0; i < 100; i++)
+    {
+	snprintf (name, len, "%s.%d.%d.tmp", fileName, (int) getpid (), i);
+	fd = open (name, O_WRONLY | O_CREAT | O_EXCL, 0666);
+	if (fd >= 0)
 	{
-    	    foundsec++;
-	    if (foundsec > n)
-		break;
+	    if (stat (fileName, &st) == 0)
+		fchmod (fd, st.st_mode & 07777);
+
+	    *tempName = name;
+	    return fd;
 	}
+
+	if (errno != EEXIST)
+	    break;
     }
 
-    if (foundsec <= n)
-	return NULL;
+    free (name);
+    return -1;
+}
+
+/* flush the directory entry of a renamed file */
+
+static void
+ini_sync_dir (const char *fileName)
+{
+    char *dir, *sep;
+    int  fd;
+
+    dir = strdup (fileName);
+    if (!dir)
+	return;
 
-    return d->key[i];
+    sep = strrchr (dir, '/');
+    if (sep == dir)
+	sep[1] = '\0';
+    else if (sep)
+	*sep = '\0';
+    else
+	strcpy (dir, ".");
+
+    fd = open (dir, O_RDONLY);
+    if (fd >= 0)
+    {
+	fsync (fd);
+	close (fd);
+    }
+
+    free (dir);
 }
 
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Save a dictionary to a loadable ini file
-  @param    d   Dictionary to dump
-  @param    f   Opened file pointer to dump to
+  @param    d           Dictionary to dump
+  @param    file_name   Name of the file to save to
   @return   void
 
   This function dumps a given dictionary into a loadable ini file.
-  It is Ok to specify @c stderr or @c stdout as output files.
+  The dictionary is written to a temporary file in the same directory
+  which then atomically replaces file_name, so readers never see a
+  partially written file. If file_name is a symbolic link, the file it
+  points to is replaced. On write errors the old file is kept.
   */
 /*--------------------------------------------------------------------------*/
 void
 iniparser_dump_ini (dictionary * d, const char * file_name)
 {
-    int     i, j;
-    char    keym[ASCIILINESZ+1];
-    int     nsec;
+    int     i, j, fd;
     char *  secname;
-    int     seclen;
+    char *  key;
+    char *  val;
+    char *  target;
+    char *  tempName;
     FILE *  f;
-    FileLock *lock;
+    Bool    ok;
 
     if (!d)
     	return;
 
-    lock = ini_file_lock (file_name, TRUE);
-    if (!lock)
+    target = realpath (file_name, NULL);
+    if (!target)
+	target = strdup (file_name);
+    if (!target)
+	return;
+
+    fd = ini_create_temp (target, &tempName);
+    if (fd < 0)
+    {
+	free (target);
 	return;
+    }
 
-    f = fdopen (lock->fd, "w");
+    f = fdopen (fd, "w");
     if (!f)
     {
-	ini_file_unlock (lock);
+	close (fd);
+	unlink (tempName);
+	free (tempName);
+	free (target);
 	return;
     }
 
-    nsec = iniparser_getnsec (d);
-    if (nsec < 1)
+    if (iniparser_getnsec (d) < 1)
     {
 	/* No section in file: dump all keys as they are */
 	for (i = 0; i < d->size; i++)
@@ -688,37 +1358,40 @@ iniparser_dump_ini (dictionary * d, const char * file_name)
 		continue;
 	    fprintf (f, "%s = %s\n", d->key[i], d->val[i]);
 	}
-
-	fflush (f);
-	ini_file_unlock (lock);
-	return;
     }
-
-    for (i = 0; i < nsec; i++)
+    else
     {
-	secname = iniparser_getsecname (d, i);
-	seclen  = (int) strlen (secname);
-	fprintf (f, "[%s]\n", secname);
-	sprintf (keym, "%s:", secname);
-
-	for (j = 0; j < d->size; j++)
+	for (i = iniparser_next_section (d, -1, &secname); i >= 0;
+	     i = iniparser_next_section (d, i, &secname))
 	{
-	    if (!d->key[j])
-		continue;
+	    fprintf (f, "[%s]\n", secname);
 
-	    if (!strncmp (d->key[j], keym, seclen + 1))
+	    for (j = iniparser_next_entry (d, i, -1, &key, &val); j >= 0;
+		 j = iniparser_next_entry (d, i, j, &key, &val))
 	    {
-    		fprintf (f, "%s = %s\n",
-		       	 d->key[j] + seclen + 1,
-	    		 d->val[j] ? d->val[j] : "");
-    	    }
+		fprintf (f, "%s = %s\n", key, val ? val : "");
+	    }
+
+	    fprintf (f, "\n");
 	}
+    }
 
-    	fprintf (f, "\n");
+    ok = (fflush (f) == 0 && !ferror (f));
+    if (ok && iniSyncOnSave)
+	ok = (fsync (fd) == 0);
+    if (fclose (f) != 0)
+	ok = FALSE;
+
+    if (ok && rename (tempName, target) == 0)
+    {
+	if (iniSyncOnSave)
+	    ini_sync_dir (target);
     }
+    else
+	unlink (tempName);
 
-    fflush (f);
-    ini_file_unlock (lock );
+    free (tempName);
+    free (target);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -746,7 +1419,7 @@ iniparser_getstring (dictionary * d, char * key, char * def)
 	return def;
 
     lc_key = strdup (strlwc (key));
-    sval = dictionary_get (d, lc_key, def);
+    sval = dictionary_get (d, lc_key, dictionary_hash (lc_key), def);
     free (lc_key);
 
     return sval;
@@ -793,7 +1466,9 @@ iniparser_find_entry (dictionary  *ini, char *entry)
 int
 iniparser_setstr (dictionary * ini, char * entry, char * val)
 {
-    dictionary_set (ini, strlwc (entry), val);
+    char *lc_entry = strlwc (entry);
+
+    dictionary_set (ini, lc_entry, dictionary_hash (lc_entry), val);
     return 0;
 }
 
@@ -810,7 +1485,256 @@ iniparser_setstr (dictionary * ini, char * entry, char * val)
 void
 iniparser_unset (dictionary * ini, char * entry)
 {
-    dictionary_unset (ini, strlwc (entry));
+    char *lc_entry = strlwc (entry);
+
+    dictionary_unset (ini, lc_entry, dictionary_hash (lc_entry));
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compute the hash of a dictionary key.
+  @param    key     Lowercase key, as "section:key".
+  @return   Hash to pass to the iniparser_*_hash functions.
+
+  Callers looking up the same key repeatedly can keep both the lowercase
+  key and its hash around and skip the per-call conversion.
+  */
+/*--------------------------------------------------------------------------*/
+unsigned
+iniparser_hash (char * key)
+{
+    return dictionary_hash (key);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a lowercase key
+  @param    d       Dictionary to search
+  @param    key     Lowercase key string to look for
+  @param    hash    Hash of the key, as returned by iniparser_hash
+  @param    def     Default value to return if key not found.
+  @return   pointer to statically allocated character string
+
+  Same as iniparser_getstring, for a key that is already lowercase.
+  */
+/*--------------------------------------------------------------------------*/
+char*
+iniparser_getstring_hash (dictionary * d,
+			  char *       key,
+			  unsigned     hash,
+			  char *       def)
+{
+    if (!d || !key)
+	return def;
+
+    return dictionary_get (d, key, hash, def);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set an entry with a lowercase name in a dictionary.
+  @param    ini     Dictionary to modify.
+  @param    entry   Lowercase entry name
+  @param    hash    Hash of the entry name, as returned by iniparser_hash
+  @param    val     New value to associate to the entry.
+  @return   int 0 if Ok, -1 otherwise.
+
+  Same as iniparser_setstr, for an entry name that is already lowercase.
+  */
+/*--------------------------------------------------------------------------*/
+int
+iniparser_setstr_hash (dictionary * ini,
+		       char *       entry,
+		       unsigned     hash,
+		       char *       val)
+{
+    dictionary_set (ini, entry, hash, val);
+    return 0;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete an entry with a lowercase name in a dictionary
+  @param    ini     Dictionary to modify
+  @param    entry   Lowercase entry name
+  @param    hash    Hash of the entry name, as returned by iniparser_hash
+  @return   void
+
+  Same as iniparser_unset, for an entry name that is already lowercase.
+  */
+/*--------------------------------------------------------------------------*/
+void
+iniparser_unset_hash (dictionary * ini, char * entry, unsigned hash)
+{
+    dictionary_unset (ini, entry, hash);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Copy a string into a growable buffer.
+  @param    buf     Buffer to copy to, reallocated as needed.
+  @param    bufSize Allocated size of the buffer.
+  @param    offset  Offset in the buffer to copy to.
+  @param    s       Start of the string to copy.
+  @param    len     Length of the string to copy.
+  @param    lower   Whether to convert the string to lowercase.
+  @return   int 0 if Ok, -1 otherwise.
+
+  The copied string is null terminated.
+  */
+/*--------------------------------------------------------------------------*/
+static int
+ini_buffer_copy (char       ** buf,
+		 size_t     *  bufSize,
+		 size_t        offset,
+		 const char *  s,
+		 size_t        len,
+		 Bool          lower)
+{
+    size_t i;
+
+    if (offset + len + 1 > *bufSize)
+    {
+	size_t newSize = *bufSize ? *bufSize : ASCIILINESZ;
+	char   *newBuf;
+
+	while (offset + len + 1 > newSize)
+	    newSize *= 2;
+
+	newBuf = (char *) realloc (*buf, newSize);
+	if (!newBuf)
+	    return -1;
+
+	*buf     = newBuf;
+	*bufSize = newSize;
+    }
+
+    if (lower)
+	for (i = 0; i < len; i++)
+	    (*buf)[offset + i] = (char) tolower ((int) s[i]);
+    else
+	memcpy (*buf + offset, s, len);
+
+    (*buf)[offset + len] = (char) 0;
+
+    return 0;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse the contents of an ini file into a dictionary.
+  @param    d       Dictionary to fill.
+  @param    data    File contents.
+  @param    size    Size of the file contents.
+  @return   void
+
+  Lines are tokenized in place in a single pass, without any line length
+  limit. Only the lowercased "section:key" and the value are copied
+  before being stored in the dictionary.
+  */
+/*--------------------------------------------------------------------------*/
+static void
+ini_parse_buffer (dictionary * d, const char * data, size_t size)
+{
+    const char *end = data + size;
+    const char *line, *eol, *where;
+    const char *key, *keyEnd, *val, *valEnd, *quote;
+    char       *keyBuf = NULL, *valBuf = NULL;
+    size_t     keyBufSize = 0, valBufSize = 0;
+    size_t     secLen = 0;
+
+    for (line = data; line < end; line = eol + 1)
+    {
+	eol = (const char *) memchr (line, '\n', end - line);
+	if (!eol)
+	    eol = end;
+
+	/* Skip leading spaces */
+	for (where = line; where < eol && isspace ((int) *where); where++);
+
+	if (where == eol || *where == ';' || *where == '#')
+	    continue; /* Comment lines */
+
+	if (*where == '[')
+	{
+	    const char *secEnd;
+
+	    secEnd = (const char *) memchr (where + 1, ']', eol - where - 1);
+	    if (!secEnd)
+		secEnd = eol;
+
+	    if (secEnd > where + 1)
+	    {
+		/* Valid section name */
+		secLen = secEnd - where - 1;
+		if (ini_buffer_copy (&keyBuf, &keyBufSize, 0,
+				     where + 1, secLen, TRUE) < 0)
+		    break;
+
+		dictionary_set (d, keyBuf, dictionary_hash (keyBuf), NULL);
+		continue;
+	    }
+	}
+
+	/* Entries before the first section header are dropped */
+	if (!keyBuf)
+	    continue;
+
+	/* key = value, key = "value", key = 'value' or just key */
+	key = where;
+	keyEnd = (const char *) memchr (key, '=', eol - key);
+	if (keyEnd == key)
+	    continue;
+
+	if (keyEnd)
+	{
+	    for (val = keyEnd + 1; val < eol && isspace ((int) *val); val++);
+	    valEnd = eol;
+
+	    if (val < eol && (*val == '"' || *val == '\''))
+	    {
+		quote = (const char *) memchr (val + 1, *val, eol - val - 1);
+
+		/* Quoted values may contain leading spaces, an unterminated
+		   quote extends to the end of the line */
+		if (!quote || quote > val + 1)
+		{
+		    val++;
+		    if (quote)
+			valEnd = quote;
+		}
+	    }
+	}
+	else
+	{
+	    keyEnd = eol;
+	    val = valEnd = eol;
+	}
+
+	while (keyEnd > key && isspace ((int) *(keyEnd - 1)))
+	    keyEnd--;
+	while (valEnd > val && isspace ((int) *(valEnd - 1)))
+	    valEnd--;
+
+	/* Treat "" or '' as empty value */
+	if (valEnd - val == 2 &&
+	    ((val[0] == '"' && val[1] == '"') ||
+	     (val[0] == '\'' && val[1] == '\'')))
+	    val = valEnd;
+
+	keyBuf[secLen] = ':';
+	if (ini_buffer_copy (&keyBuf, &keyBufSize, secLen + 1,
+			     key, keyEnd - key, TRUE) < 0 ||
+	    ini_buffer_copy (&valBuf, &valBufSize, 0,
+			     val, valEnd - val, FALSE) < 0)
+	    break;
+
+	dictionary_set (d, keyBuf, dictionary_hash (keyBuf), valBuf);
+	keyBuf[secLen] = (char) 0;
+    }
+
+    free (keyBuf);
+    free (valBuf);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -824,6 +1748,8 @@ iniparser_unset (dictionary * ini, char * entry)
   should not be accessed directly, but through accessor functions
   instead.
 
+  The file is memory mapped and parsed in a single pass.
+
   The returned dictionary must be freed using iniparser_free().
   */
 /*--------------------------------------------------------------------------*/
@@ -831,77 +1757,45 @@ dictionary*
 iniparser_new (char *ininame)
 {
     dictionary  *   d;
-    char        lin[ASCIILINESZ+1];
-    char        sec[ASCIILINESZ+1];
-    char        key[ASCIILINESZ+1];
-    char        val[ASCIILINESZ+1];
-    char    *   where;
-    FILE    *   ini;
-    int         lineno;
     FileLock *  lock;
+    struct stat st;
+    void        *data;
 
-    lock = ini_file_lock (ininame, FALSE);
+    lock = ini_file_lock (ininame);
     if (!lock)
 	return NULL;
 
-    ini = fopen (ininame, "r");
-    if (!ini)
+    if (fstat (lock->fd, &st) < 0)
     {
-	ini_file_unlock (lock );
+	ini_file_unlock (lock);
 	return NULL;
     }
 
-    sec[0] = 0;
-
     /*
      * Initialize a new dictionary entry
      */
     d = dictionary_new (0);
-    lineno = 0;
-
-    while (fgets (lin, ASCIILINESZ, ini) != NULL)
+    if (!d)
     {
-	lineno++;
-	where = strskp (lin); /* Skip leading spaces */
+	ini_file_unlock (lock);
+	return NULL;
+    }
 
-	if (*where == ';' || *where == '#' || *where == 0)
-	    continue; /* Comment lines */
-	else
+    if (st.st_size > 0)
+    {
+	data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, lock->fd, 0);
+	if (data == MAP_FAILED)
 	{
-	    val[0] = '\0';
-
-	    if (sscanf (where, "[%[^]]", sec) == 1)
-	    {
-		/* Valid section name */
-		strcpy (sec, strlwc (sec));
-		iniparser_add_entry (d, sec, NULL, NULL);
-	    }
-	    else if (sscanf (where, "%[^=] = \"%[^\"]\"", key, val) == 2 ||
-		     sscanf (where, "%[^=] = '%[^\']'",   key, val) == 2 ||
-		     sscanf (where, "%[^=] = %[^\n]",     key, val) >= 1)
-	    {
-    		strcpy (key, strlwc (strcrop (key)));
-		/*
-		 * sscanf cannot handle "" or '' as empty value,
-		 * this is done here
-		 */
-
-	    	if (!strcmp (val, "\"\"") || !strcmp (val, "''"))
-    		{
-		    val[0] = (char) 0;
-		}
-		else
-		{
-		    strcpy (val, strcrop (val));
-		}
-
-	    	iniparser_add_entry (d, sec, key, val);
-    	    }
+	    dictionary_del (d);
+	    ini_file_unlock (lock);
+	    return NULL;
 	}
+
+	ini_parse_buffer (d, (const char *) data, st.st_size);
+	munmap (data, st.st_size);
     }
 
-    fclose (ini);
-    ini_file_unlock (lock );
+    ini_file_unlock (lock);
 
     return d;
 }
@@ -45,21 +45,34 @@ typedef struct _FileLock
 	int fd;
 } FileLock;
 
+/* Keys and values returned by the functions below point into the string
+   storage of the dictionary. They stay valid until their own entry is
+   changed or removed, the dictionary is freed, or iniparser_compact is
+   called; other modifications don't move them. */
+
 /* generated by genproto */
 
 dictionary * iniparser_new(char *ininame);
 dictionary * dictionary_new(int size);
 void iniparser_free(dictionary * d);
+void iniparser_compact(dictionary * d);
 
 
 int iniparser_getnsec(dictionary * d);
 char * iniparser_getsecname(dictionary * d, int n);
+int iniparser_next_section(dictionary * d, int section, char ** name);
+int iniparser_next_entry(dictionary * d, int section, int entry, char ** key, char ** val);
 void iniparser_dump_ini(dictionary * d, const char * file_name);
+void iniparser_set_sync(Bool sync);
 char * iniparser_getstring(dictionary * d, char * key, char * def);
 void iniparser_add_entry(dictionary * d, char * sec, char * key, char * val);
 int iniparser_find_entry(dictionary  *   ini, char        *   entry);
 int iniparser_setstr(dictionary * ini, char * entry, char * val);
 void iniparser_unset(dictionary * ini, char * entry);
+unsigned iniparser_hash(char * key);
+char * iniparser_getstring_hash(dictionary * d, char * key, unsigned hash, char * def);
+int iniparser_setstr_hash(dictionary * ini, char * entry, unsigned hash, char * val);
+void iniparser_unset_hash(dictionary * ini, char * entry, unsigned hash);
 
 #endif
 
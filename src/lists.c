@@ -168,6 +168,46 @@ typedef void (*freeFunc) (void *ptr);
 	    free(le); \
 	} \
 	return NULL; \
+    } \
+    \
+    Bool ccs##type##SeqAppend (CCS##type##Seq *seq, dtype *data) \
+    { \
+	CCS##type##List ne = malloc(sizeof(struct _CCS##type##List)); \
+	if (!ne) \
+	    return FALSE; \
+	ne->data = data; \
+	ne->next = NULL; \
+	if (seq->tail) \
+	    seq->tail->next = ne; \
+	else \
+	    seq->head = ne; \
+	seq->tail = ne; \
+	seq->length++; \
+	return TRUE; \
+    } \
+    \
+    void ccs##type##SeqAdopt (CCS##type##Seq *seq, CCS##type##List list) \
+    { \
+	seq->head = list; \
+	seq->tail = NULL; \
+	seq->length = 0; \
+	for (; list; list = list->next) \
+	{ \
+	    seq->tail = list; \
+	    seq->length++; \
+	} \
+    } \
+    \
+    unsigned int ccs##type##SeqLength (CCS##type##Seq *seq) \
+    { \
+	return seq->length; \
+    } \
+    \
+    void ccs##type##SeqFree (CCS##type##Seq *seq, Bool freeObj) \
+    { \
+	ccs##type##ListFree (seq->head, freeObj); \
+	seq->head = seq->tail = NULL; \
+	seq->length = 0; \
     }
 
 CCSLIST (Plugin, CCSPlugin, FALSE, 0)
@@ -177,6 +217,7 @@ CCSLIST (Group, CCSGroup, FALSE, 0)
 CCSLIST (SubGroup, CCSSubGroup, FALSE, 0)
 CCSLIST (SettingValue, CCSSettingValue, FALSE, 0)
 CCSLIST (PluginConflict, CCSPluginConflict, FALSE, 0)
+CCSLIST (PluginConflictStatus, CCSPluginConflictStatus, FALSE, 0)
 CCSLIST (BackendInfo, CCSBackendInfo, FALSE, 0)
 CCSLIST (IntDesc, CCSIntDesc, FALSE, 0)
 CCSLIST (StrRestriction, CCSStrRestriction, FALSE, 0)
@@ -185,35 +226,35 @@ CCSLIST (StrExtension, CCSStrExtension, FALSE, 0)
 CCSSettingValueList ccsGetValueListFromStringList (CCSStringList list,
 						   CCSSetting *parent)
 {
-    CCSSettingValueList rv = NULL;
+    CCSSettingValueSeq rv = { NULL, NULL, 0 };
 
     while (list)
     {
 	CCSSettingValue *value = calloc (1, sizeof (CCSSettingValue));
 	if (!value)
-	    return rv;
+	    return rv.head;
 
 	value->isListChild = TRUE;
 	value->parent = parent;
 	value->value.asString = strdup (list->data);
-	rv = ccsSettingValueListAppend (rv, value);
+	ccsSettingValueSeqAppend (&rv, value);
 	list = list->next;
     }
 
-    return rv;
+    return rv.head;
 }
 
 CCSStringList ccsGetStringListFromValueList (CCSSettingValueList list)
 {
-    CCSStringList rv = NULL;
+    CCSStringSeq rv = { NULL, NULL, 0 };
 
     while (list)
     {
-	rv = ccsStringListAppend (rv, strdup (list->data->value.asString) );
+	ccsStringSeqAppend (&rv, strdup (list->data->value.asString) );
 	list = list->next;
     }
 
-    return rv;
+    return rv.head;
 }
 
 char ** ccsGetStringArrayFromList (CCSStringList list, int *num)
@@ -239,13 +280,13 @@ char ** ccsGetStringArrayFromList (CCSStringList list, int *num)
 
 CCSStringList ccsGetListFromStringArray (char ** array, int num)
 {
-    CCSStringList rv = NULL;
+    CCSStringSeq rv = { NULL, NULL, 0 };
     int i;
 
     for (i = 0; i < num; i++)
-	rv = ccsStringListAppend (rv, strdup (array[i]) );
+	ccsStringSeqAppend (&rv, strdup (array[i]) );
 
-    return rv;
+    return rv.head;
 }
 
 char ** ccsGetStringArrayFromValueList (CCSSettingValueList list, int *num)
@@ -379,126 +420,126 @@ CCSSettingColorValue * ccsGetColorArrayFromValueList (CCSSettingValueList list,
 CCSSettingValueList ccsGetValueListFromStringArray (char ** array, int num,
 						    CCSSetting *parent)
 {
-    CCSSettingValueList l = NULL;
+    CCSSettingValueSeq l = { NULL, NULL, 0 };
     int i;
 
     for (i = 0; i < num; i++)
     {
 	CCSSettingValue *value = calloc (1, sizeof (CCSSettingValue));
 	if (!value)
-	    return l;
+	    return l.head;
 
 	value->isListChild = TRUE;
 	value->parent = parent;
 	value->value.asString = strdup (array[i]);
-	l = ccsSettingValueListAppend (l, value);
+	ccsSettingValueSeqAppend (&l, value);
     }
 
-    return l;
+    return l.head;
 }
 
 CCSSettingValueList ccsGetValueListFromMatchArray (char ** array, int num,
 						   CCSSetting *parent)
 {
-    CCSSettingValueList l = NULL;
+    CCSSettingValueSeq l = { NULL, NULL, 0 };
     int i;
 
     for (i = 0; i < num; i++)
     {
 	CCSSettingValue *value = calloc (1, sizeof (CCSSettingValue));
 	if (!value)
-	    return l;
+	    return l.head;
 
 	value->isListChild = TRUE;
 	value->parent = parent;
 	value->value.asMatch = strdup (array[i]);
-	l = ccsSettingValueListAppend (l, value);
+	ccsSettingValueSeqAppend (&l, value);
     }
 
-    return l;
+    return l.head;
 }
 
 CCSSettingValueList ccsGetValueListFromIntArray (int * array, int num,
 						 CCSSetting *parent)
 {
-    CCSSettingValueList l = NULL;
+    CCSSettingValueSeq l = { NULL, NULL, 0 };
     int i;
 
     for (i = 0; i < num; i++)
     {
 	CCSSettingValue *value = calloc (1, sizeof (CCSSettingValue));
 	if (!value)
-	    return l;
+	    return l.head;
 
 	value->isListChild = TRUE;
 	value->parent = parent;
 	value->value.asInt = array[i];
-	l = ccsSettingValueListAppend (l, value);
+	ccsSettingValueSeqAppend (&l, value);
     }
 
-    return l;
+    return l.head;
 }
 
 CCSSettingValueList ccsGetValueListFromFloatArray (float * array, int num,
 						   CCSSetting *parent)
 {
-    CCSSettingValueList l = NULL;
+    CCSSettingValueSeq l = { NULL, NULL, 0 };
     int i;
 
     for (i = 0; i < num; i++)
     {
 	CCSSettingValue *value = calloc (1, sizeof (CCSSettingValue));
 	if (!value)
-	    return l;
+	    return l.head;
 
 	value->isListChild = TRUE;
 	value->parent = parent;
 	value->value.asFloat = array[i];
-	l = ccsSettingValueListAppend (l, value);
+	ccsSettingValueSeqAppend (&l, value);
     }
 
-    return l;
+    return l.head;
 }
 
 CCSSettingValueList ccsGetValueListFromBoolArray (Bool * array, int num,
 						  CCSSetting *parent)
 {
-    CCSSettingValueList l = NULL;
+    CCSSettingValueSeq l = { NULL, NULL, 0 };
     int i;
 
     for (i = 0; i < num; i++)
     {
 	CCSSettingValue *value = calloc (1, sizeof (CCSSettingValue));
 	if (!value)
-	    return l;
+	    return l.head;
 
 	value->isListChild = TRUE;
 	value->parent = parent;
 	value->value.asBool = array[i];
-	l = ccsSettingValueListAppend (l, value);
+	ccsSettingValueSeqAppend (&l, value);
     }
 
-    return l;
+    return l.head;
 }
 
 CCSSettingValueList ccsGetValueListFromColorArray (CCSSettingColorValue * array,
 						   int num, CCSSetting *parent)
 {
-    CCSSettingValueList l = NULL;
+    CCSSettingValueSeq l = { NULL, NULL, 0 };
     int i;
 
     for (i = 0; i < num; i++)
     {
 	CCSSettingValue *value = calloc (1, sizeof (CCSSettingValue));
 	if (!value)
-	    return l;
+	    return l.head;
 
 	value->isListChild = TRUE;
 	value->parent = parent;
 	value->value.asColor = array[i];
-	l = ccsSettingValueListAppend (l, value);
+	ccsSettingValueSeqAppend (&l, value);
     }
 
-    return l;
+    return l.head;
 }
 
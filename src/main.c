@@ -32,6 +32,7 @@
 #include <dlfcn.h>
 #include <dirent.h>
 #include <math.h>
+#include <stdint.h>
 
 #include <ccs.h>
 
@@ -39,6 +40,8 @@
 #include "iniparser.h"
 
 Bool basicMetadata = FALSE;
+Bool eagerMetadata = FALSE;
+Bool lazyDescriptions = FALSE;
 
 void
 ccsSetBasicMetadata (Bool value)
@@ -46,6 +49,18 @@ ccsSetBasicMetadata (Bool value)
     basicMetadata = value;
 }
 
+void
+ccsSetEagerMetadata (Bool value)
+{
+    eagerMetadata = value;
+}
+
+void
+ccsSetLazyDescriptions (Bool value)
+{
+    lazyDescriptions = value;
+}
+
 char *
 strdup_printf (const char *format, ...)
 {
@@ -139,6 +154,9 @@ ccsEmptyContextNew (unsigned int *screens, unsigned int numScreens)
 
     CONTEXT_PRIV (context);
 
+    /* settings start out with epoch 0, i.e. not changed */
+    cPrivate->changedEpoch = 1;
+
     if (numScreens > 0 && screens)
     {
 	int i;
@@ -169,6 +187,8 @@ ccsEmptyContextNew (unsigned int *screens, unsigned int numScreens)
 	context->numScreens = 1;
     }
 
+    pthread_mutex_init (&cPrivate->stringPoolLock, NULL);
+
     initGeneralOptions (context);
     cPrivate->configWatchId = ccsAddConfigWatch (context, configChangeNotify);
 
@@ -182,6 +202,196 @@ ccsEmptyContextNew (unsigned int *screens, unsigned int numScreens)
     return context;
 }
 
+/* The conflict checks look plugins and features up in a reverse index
+   of the plugin relations, so they only visit the plugins involved. It
+   is built on the first check and dropped when a plugin is added, as
+   the relations are only read when plugins are enumerated. The number
+   of active providers of each feature follows setPluginActive. */
+
+static CCSPluginRelations *
+pluginRelationsSlot (CCSPluginRelations *relations,
+		     unsigned int       size,
+		     const char         *name)
+{
+    unsigned int mask = size - 1;
+    unsigned int i;
+
+    for (i = iniparser_hash ((char *) name) & mask; relations[i].name;
+	 i = (i + 1) & mask)
+    {
+	if (!strcmp (relations[i].name, name))
+	    break;
+    }
+
+    return &relations[i];
+}
+
+static CCSPluginRelations *
+findPluginRelations (CCSContextPrivate *cPrivate,
+		     const char        *name)
+{
+    CCSPluginRelations *r;
+
+    if (!cPrivate->relations || !name)
+	return NULL;
+
+    r = pluginRelationsSlot (cPrivate->relations, cPrivate->relationsSize,
+			     name);
+
+    return r->name ? r : NULL;
+}
+
+static CCSPluginRelations *
+addPluginRelations (CCSContextPrivate *cPrivate,
+		    const char        *name)
+{
+    CCSPluginRelations *r;
+    unsigned int       i;
+
+    if ((cPrivate->relationsCount + 1) * 2 > cPrivate->relationsSize)
+    {
+	CCSPluginRelations *old = cPrivate->relations;
+	unsigned int       oldSize = cPrivate->relationsSize;
+	unsigned int       size = oldSize ? oldSize * 2 : 64;
+
+	cPrivate->relations = calloc (size, sizeof (CCSPluginRelations));
+	if (cPrivate->relations)
+	{
+	    cPrivate->relationsSize = size;
+
+	    for (i = 0; i < oldSize; i++)
+		if (old[i].name)
+		    *pluginRelationsSlot (cPrivate->relations, size,
+					  old[i].name) = old[i];
+
+	    if (old)
+		free (old);
+	}
+	else
+	{
+	    /* keep filling the old table while there is room */
+	    cPrivate->relations = old;
+	    if (cPrivate->relationsCount + 1 >= oldSize)
+		return NULL;
+	}
+    }
+
+    r = pluginRelationsSlot (cPrivate->relations, cPrivate->relationsSize,
+			     name);
+    if (!r->name)
+    {
+	r->name = name;
+	cPrivate->relationsCount++;
+    }
+
+    return r;
+}
+
+static void
+freePluginRelations (CCSContextPrivate *cPrivate)
+{
+    unsigned int i;
+
+    for (i = 0; i < cPrivate->relationsSize; i++)
+    {
+	CCSPluginRelations *r = &cPrivate->relations[i];
+
+	ccsPluginSeqFree (&r->providers, FALSE);
+	ccsPluginSeqFree (&r->featureUsers, FALSE);
+	ccsPluginSeqFree (&r->dependents, FALSE);
+    }
+
+    if (cPrivate->relations)
+	free (cPrivate->relations);
+
+    cPrivate->relations = NULL;
+    cPrivate->relationsSize = 0;
+    cPrivate->relationsCount = 0;
+    cPrivate->relationsValid = FALSE;
+}
+
+static void
+buildPluginRelations (CCSContext *context)
+{
+    CCSPluginList      pl;
+    CCSStringList      sl;
+    CCSPluginRelations *r;
+
+    CONTEXT_PRIV (context);
+
+    for (pl = context->plugins; pl; pl = pl->next)
+    {
+	CCSPlugin *p = pl->data;
+
+	PLUGIN_PRIV (p);
+
+	for (sl = p->providesFeature; sl; sl = sl->next)
+	{
+	    r = addPluginRelations (cPrivate, sl->data);
+	    if (r && ccsPluginSeqAppend (&r->providers, p) &&
+		pPrivate->active)
+		r->activeProviders++;
+	}
+
+	for (sl = p->requiresFeature; sl; sl = sl->next)
+	{
+	    r = addPluginRelations (cPrivate, sl->data);
+	    if (r)
+		ccsPluginSeqAppend (&r->featureUsers, p);
+	}
+
+	for (sl = p->requiresPlugin; sl; sl = sl->next)
+	{
+	    r = addPluginRelations (cPrivate, sl->data);
+	    if (r && (!r->dependents.tail || r->dependents.tail->data != p))
+		ccsPluginSeqAppend (&r->dependents, p);
+	}
+    }
+
+    cPrivate->relationsValid = TRUE;
+}
+
+static CCSPluginRelations *
+getPluginRelations (CCSContext *context,
+		    const char *name)
+{
+    CONTEXT_PRIV (context);
+
+    if (!cPrivate->relationsValid)
+	buildPluginRelations (context);
+
+    return findPluginRelations (cPrivate, name);
+}
+
+static void
+setPluginActive (CCSPlugin *plugin,
+		 Bool      value)
+{
+    CCSStringList sl;
+
+    PLUGIN_PRIV (plugin);
+    CONTEXT_PRIV (plugin->context);
+
+    if (!pPrivate->active != !value && cPrivate->relationsValid)
+    {
+	for (sl = plugin->providesFeature; sl; sl = sl->next)
+	{
+	    CCSPluginRelations *r = findPluginRelations (cPrivate, sl->data);
+
+	    /* the plugin is missing if appending it failed */
+	    if (r && ccsPluginListFind (r->providers.head, plugin))
+	    {
+		if (value)
+		    r->activeProviders++;
+		else
+		    r->activeProviders--;
+	    }
+	}
+    }
+
+    pPrivate->active = value;
+}
+
 static void
 ccsSetActivePluginList (CCSContext * context, CCSStringList list)
 {
@@ -189,29 +399,20 @@ ccsSetActivePluginList (CCSContext * context, CCSStringList list)
     CCSPlugin     *plugin;
 
     for (l = context->plugins; l; l = l->next)
-    {
-	PLUGIN_PRIV (l->data);
-	pPrivate->active = FALSE;
-    }
+	setPluginActive (l->data, FALSE);
 
     for (; list; list = list->next)
     {
 	plugin = ccsFindPlugin (context, list->data);
 
 	if (plugin)
-	{
-	    PLUGIN_PRIV (plugin);
-	    pPrivate->active = TRUE;
-	}
+	    setPluginActive (plugin, TRUE);
     }
 
     /* core plugin is always active */
     plugin = ccsFindPlugin (context, "core");
     if (plugin)
-    {
-	PLUGIN_PRIV (plugin);
-	pPrivate->active = TRUE;
-    }
+	setPluginActive (plugin, TRUE);
 }
 
 CCSContext *
@@ -245,136 +446,636 @@ ccsContextNew (unsigned int *screens, unsigned int numScreens)
 	}
     }
 
-    return context;
-}
+    return context;
+}
+
+/* Plugins are indexed by name in an open addressing hash table which
+   is kept at most half full, so lookups don't depend on the number of
+   plugins. */
+
+static void
+insertPluginIndex (CCSContextPrivate *cPrivate,
+		   CCSPlugin         *plugin)
+{
+    unsigned int mask = cPrivate->pluginIndexSize - 1;
+    unsigned int i = iniparser_hash (plugin->name) & mask;
+
+    while (cPrivate->pluginIndex[i])
+	i = (i + 1) & mask;
+
+    cPrivate->pluginIndex[i] = plugin;
+}
+
+static Bool
+growPluginIndex (CCSContextPrivate *cPrivate)
+{
+    CCSPlugin    **oldIndex = cPrivate->pluginIndex;
+    unsigned int oldSize = cPrivate->pluginIndexSize;
+    unsigned int i;
+
+    cPrivate->pluginIndexSize = oldSize ? oldSize * 2 : 64;
+    cPrivate->pluginIndex = calloc (cPrivate->pluginIndexSize,
+				    sizeof (CCSPlugin *));
+    if (!cPrivate->pluginIndex)
+    {
+	/* fall back to searching the plugin list */
+	cPrivate->pluginIndexSize = 0;
+	if (oldIndex)
+	    free (oldIndex);
+	return FALSE;
+    }
+
+    for (i = 0; i < oldSize; i++)
+	if (oldIndex[i])
+	    insertPluginIndex (cPrivate, oldIndex[i]);
+
+    if (oldIndex)
+	free (oldIndex);
+
+    return TRUE;
+}
+
+void
+ccsAddPluginToContext (CCSContext *context,
+		       CCSPlugin  *plugin)
+{
+    CONTEXT_PRIV (context);
+
+    /* pick up the list if it was replaced from outside */
+    if (cPrivate->plugins.head != context->plugins)
+	ccsPluginSeqAdopt (&cPrivate->plugins, context->plugins);
+
+    if (!ccsPluginSeqAppend (&cPrivate->plugins, plugin))
+	return;
+
+    context->plugins = cPrivate->plugins.head;
+
+    if (cPrivate->relationsValid)
+	freePluginRelations (cPrivate);
+
+    /* index dropped after an allocation failure */
+    if (!cPrivate->pluginIndex &&
+	ccsPluginSeqLength (&cPrivate->plugins) > 1)
+	return;
+
+    if (ccsPluginSeqLength (&cPrivate->plugins) * 2 >
+	cPrivate->pluginIndexSize &&
+	!growPluginIndex (cPrivate))
+	return;
+
+    insertPluginIndex (cPrivate, plugin);
+}
+
+CCSPlugin *
+ccsFindPlugin (CCSContext * context, const char *name)
+{
+    unsigned int mask, i;
+
+    if (!name)
+	name = "";
+
+    CONTEXT_PRIV (context);
+
+    if (!cPrivate->pluginIndex)
+    {
+	CCSPluginList l;
+
+	for (l = context->plugins; l; l = l->next)
+	    if (!strcmp (l->data->name, name))
+		return l->data;
+
+	return NULL;
+    }
+
+    mask = cPrivate->pluginIndexSize - 1;
+
+    for (i = iniparser_hash ((char *) name) & mask; cPrivate->pluginIndex[i];
+	 i = (i + 1) & mask)
+    {
+	if (!strcmp (cPrivate->pluginIndex[i]->name, name))
+	    return cPrivate->pluginIndex[i];
+    }
+
+    return NULL;
+}
+
+/* Metadata strings like groups, descriptions and dependencies repeat a
+   lot between settings and plugins, so they are kept once per context.
+   Interned strings belong to the pool and are only freed with the
+   context; a group or subgroup can be compared by its pointer. */
+
+static void
+insertStringPool (CCSContextPrivate *cPrivate,
+		  char              *str)
+{
+    unsigned int mask = cPrivate->stringPoolSize - 1;
+    unsigned int i = iniparser_hash (str) & mask;
+
+    while (cPrivate->stringPool[i])
+	i = (i + 1) & mask;
+
+    cPrivate->stringPool[i] = str;
+}
+
+static Bool
+growStringPool (CCSContextPrivate *cPrivate)
+{
+    char         **oldPool = cPrivate->stringPool;
+    unsigned int oldSize = cPrivate->stringPoolSize;
+    unsigned int i;
+
+    /* unlike the indices the old table is kept on failure, it owns the
+       strings */
+    cPrivate->stringPool = calloc (oldSize ? oldSize * 2 : 1024,
+				   sizeof (char *));
+    if (!cPrivate->stringPool)
+    {
+	cPrivate->stringPool = oldPool;
+	return FALSE;
+    }
+
+    cPrivate->stringPoolSize = oldSize ? oldSize * 2 : 1024;
+
+    for (i = 0; i < oldSize; i++)
+	if (oldPool[i])
+	    insertStringPool (cPrivate, oldPool[i]);
+
+    if (oldPool)
+	free (oldPool);
+
+    return TRUE;
+}
+
+/* Returns the copy of str kept in the pool of the context, which must
+   not be freed, or NULL if it couldn't be added */
+char *
+ccsInternString (CCSContext *context,
+		 const char *str)
+{
+    unsigned int hash, mask, i;
+    char         *interned = NULL;
+
+    if (!str)
+	return NULL;
+
+    CONTEXT_PRIV (context);
+
+    hash = iniparser_hash ((char *) str);
+
+    pthread_mutex_lock (&cPrivate->stringPoolLock);
+
+    if (cPrivate->stringPoolSize)
+    {
+	mask = cPrivate->stringPoolSize - 1;
+
+	for (i = hash & mask; cPrivate->stringPool[i]; i = (i + 1) & mask)
+	{
+	    if (!strcmp (cPrivate->stringPool[i], str))
+	    {
+		interned = cPrivate->stringPool[i];
+		/* what a copy would have taken, with its malloc header */
+		cPrivate->stringPoolSaved += malloc_usable_size (interned) +
+					     sizeof (size_t);
+		break;
+	    }
+	}
+    }
+
+    if (!interned &&
+	((cPrivate->stringPoolCount + 1) * 2 <= cPrivate->stringPoolSize ||
+	 growStringPool (cPrivate) ||
+	 cPrivate->stringPoolCount + 1 < cPrivate->stringPoolSize))
+    {
+	interned = strdup (str);
+	if (interned)
+	{
+	    insertStringPool (cPrivate, interned);
+	    cPrivate->stringPoolCount++;
+	}
+    }
+
+    pthread_mutex_unlock (&cPrivate->stringPoolLock);
+
+    return interned;
+}
+
+/* Like ccsInternString, for a string which is freed */
+char *
+ccsInternOwnedString (CCSContext *context,
+		      char       *str)
+{
+    char *interned = ccsInternString (context, str);
+
+    if (str)
+	free (str);
+
+    return interned;
+}
+
+static void
+freeStringPool (CCSContextPrivate *cPrivate)
+{
+    unsigned int i;
+
+    D (D_FULL, "Interned strings: %u, %lu bytes saved\n",
+       cPrivate->stringPoolCount, (unsigned long) cPrivate->stringPoolSaved);
+
+    for (i = 0; i < cPrivate->stringPoolSize; i++)
+	if (cPrivate->stringPool[i])
+	    free (cPrivate->stringPool[i]);
+
+    if (cPrivate->stringPool)
+	free (cPrivate->stringPool);
+
+    pthread_mutex_destroy (&cPrivate->stringPoolLock);
+}
+
+/* Settings are indexed like plugins, by name and - for screen
+   settings - screen number. */
+
+static unsigned int
+settingHash (const char   *name,
+	     Bool         isScreen,
+	     unsigned int screenNum)
+{
+    unsigned int hash = iniparser_hash ((char *) name);
+
+    if (isScreen)
+	hash ^= (screenNum + 1) * 0x9e3779b1;
+
+    return hash;
+}
+
+static Bool
+settingMatches (CCSSetting   *setting,
+		const char   *name,
+		Bool         isScreen,
+		unsigned int screenNum)
+{
+    return (!strcmp (setting->name, name) &&
+	    ((!setting->isScreen && !isScreen) ||
+	     (setting->isScreen && isScreen)) &&
+	    (!isScreen || (setting->screenNum == screenNum)));
+}
+
+static void
+insertSettingIndex (CCSPluginPrivate *pPrivate,
+		    CCSSetting       *setting)
+{
+    unsigned int mask = pPrivate->settingIndexSize - 1;
+    unsigned int i;
+
+    i = settingHash (setting->name, setting->isScreen,
+		     setting->screenNum) & mask;
+
+    while (pPrivate->settingIndex[i])
+	i = (i + 1) & mask;
+
+    pPrivate->settingIndex[i] = setting;
+}
+
+static Bool
+growSettingIndex (CCSPluginPrivate *pPrivate)
+{
+    CCSSetting   **oldIndex = pPrivate->settingIndex;
+    unsigned int oldSize = pPrivate->settingIndexSize;
+    unsigned int i;
+
+    pPrivate->settingIndexSize = oldSize ? oldSize * 2 : 64;
+    pPrivate->settingIndex = calloc (pPrivate->settingIndexSize,
+				     sizeof (CCSSetting *));
+    if (!pPrivate->settingIndex)
+    {
+	/* fall back to searching the setting list */
+	pPrivate->settingIndexSize = 0;
+	if (oldIndex)
+	    free (oldIndex);
+	return FALSE;
+    }
+
+    for (i = 0; i < oldSize; i++)
+	if (oldIndex[i])
+	    insertSettingIndex (pPrivate, oldIndex[i]);
+
+    if (oldIndex)
+	free (oldIndex);
+
+    return TRUE;
+}
+
+void
+ccsAddSettingToPlugin (CCSPlugin  *plugin,
+		       CCSSetting *setting)
+{
+    PLUGIN_PRIV (plugin);
+
+    if (!ccsSettingSeqAppend (&pPrivate->settings, setting))
+	return;
+
+    /* index dropped after an allocation failure */
+    if (!pPrivate->settingIndex &&
+	ccsSettingSeqLength (&pPrivate->settings) > 1)
+	return;
+
+    if (ccsSettingSeqLength (&pPrivate->settings) * 2 >
+	pPrivate->settingIndexSize &&
+	!growSettingIndex (pPrivate))
+	return;
+
+    insertSettingIndex (pPrivate, setting);
+}
+
+CCSSetting *
+ccsFindSetting (CCSPlugin * plugin, const char *name,
+		Bool isScreen, unsigned int screenNum)
+{
+    unsigned int mask, i;
+
+    if (!plugin)
+	return NULL;
+
+    PLUGIN_PRIV (plugin);
+
+    if (!name)
+	name = "";
+
+    if (!pPrivate->loaded)
+	ccsLoadPluginSettings (plugin);
+
+    if (!pPrivate->settingIndex)
+    {
+	CCSSettingList l;
+
+	for (l = pPrivate->settings.head; l; l = l->next)
+	    if (settingMatches (l->data, name, isScreen, screenNum))
+		return l->data;
+
+	return NULL;
+    }
+
+    mask = pPrivate->settingIndexSize - 1;
+
+    for (i = settingHash (name, isScreen, screenNum) & mask;
+	 pPrivate->settingIndex[i]; i = (i + 1) & mask)
+    {
+	if (settingMatches (pPrivate->settingIndex[i], name,
+			    isScreen, screenNum))
+	    return pPrivate->settingIndex[i];
+    }
+
+    return NULL;
+}
+
+Bool
+ccsPluginIsActive (CCSContext * context, char *name)
+{
+    CCSPlugin *plugin;
+
+    plugin = ccsFindPlugin (context, name);
+    if (!plugin)
+	return FALSE;
+
+    PLUGIN_PRIV (plugin);
+
+    return pPrivate->active;
+}
+
+
+/* Groups are built on the first ccsGetPluginGroups, in one pass over
+   the settings. Group and subgroup names are interned, so they are
+   hashed and matched by pointer. */
+
+typedef struct _GroupSlot
+{
+    const char     *name;
+    CCSGroup       *group;
+    CCSSubGroupSeq subGroups;
+} GroupSlot;
+
+typedef struct _SubGroupSlot
+{
+    CCSGroup      *group;
+    const char    *name;
+    CCSSubGroup   *subGroup;
+    CCSSettingSeq settings;
+} SubGroupSlot;
+
+/* both tables are kept at most half full, like the plugin index */
+typedef struct _GroupTables
+{
+    GroupSlot    *groups;
+    unsigned int groupsSize;
+    unsigned int numGroups;
+
+    SubGroupSlot *subGroups;
+    unsigned int subGroupsSize;
+    unsigned int numSubGroups;
+} GroupTables;
 
-CCSPlugin *
-ccsFindPlugin (CCSContext * context, const char *name)
+static unsigned int
+pointerHash (const void *p)
 {
-    if (!name)
-	name = "";
+    uintptr_t v = (uintptr_t) p >> 4;
 
-    CCSPluginList l = context->plugins;
-    while (l)
-    {
-	if (!strcmp (l->data->name, name))
-	    return l->data;
+    return (unsigned int) ((v ^ (v >> 16)) * 0x9e3779b1);
+}
 
-	l = l->next;
-    }
+static GroupSlot *
+findGroupSlot (GroupSlot    *groups,
+	       unsigned int size,
+	       const char   *name)
+{
+    unsigned int mask = size - 1;
+    unsigned int i;
 
-    return NULL;
+    for (i = pointerHash (name) & mask; groups[i].group; i = (i + 1) & mask)
+	if (groups[i].name == name)
+	    break;
+
+    return &groups[i];
 }
 
-CCSSetting *
-ccsFindSetting (CCSPlugin * plugin, const char *name,
-		Bool isScreen, unsigned int screenNum)
+static SubGroupSlot *
+findSubGroupSlot (SubGroupSlot *subGroups,
+		  unsigned int size,
+		  CCSGroup     *group,
+		  const char   *name)
 {
-    if (!plugin)
-	return NULL;
+    unsigned int mask = size - 1;
+    unsigned int i;
 
-    PLUGIN_PRIV (plugin);
+    for (i = (pointerHash (name) ^ pointerHash (group)) & mask;
+	 subGroups[i].subGroup; i = (i + 1) & mask)
+	if (subGroups[i].group == group && subGroups[i].name == name)
+	    break;
 
-    if (!name)
-	name = "";
+    return &subGroups[i];
+}
 
-    if (!pPrivate->loaded)
-	ccsLoadPluginSettings (plugin);
+static Bool
+growGroupSlots (GroupTables *t)
+{
+    unsigned int size = t->groupsSize * 2;
+    GroupSlot    *groups;
+    unsigned int i;
 
-    CCSSettingList l = pPrivate->settings;
+    groups = calloc (size, sizeof (GroupSlot));
+    if (!groups)
+	return FALSE;
 
-    while (l)
-    {
-	if (!strcmp (l->data->name, name) &&
-	    ((!l->data->isScreen && !isScreen) ||
-	     (l->data->isScreen && isScreen)) &&
-	    (!isScreen || (l->data->screenNum == screenNum)))
-	    return l->data;
+    for (i = 0; i < t->groupsSize; i++)
+	if (t->groups[i].group)
+	    *findGroupSlot (groups, size, t->groups[i].name) = t->groups[i];
 
-	l = l->next;
-    }
+    free (t->groups);
+    t->groups = groups;
+    t->groupsSize = size;
 
-    return NULL;
+    return TRUE;
 }
 
-Bool
-ccsPluginIsActive (CCSContext * context, char *name)
+static Bool
+growSubGroupSlots (GroupTables *t)
 {
-    CCSPlugin *plugin;
+    unsigned int size = t->subGroupsSize * 2;
+    SubGroupSlot *subGroups;
+    unsigned int i;
 
-    plugin = ccsFindPlugin (context, name);
-    if (!plugin)
+    subGroups = calloc (size, sizeof (SubGroupSlot));
+    if (!subGroups)
 	return FALSE;
 
-    PLUGIN_PRIV (plugin);
+    for (i = 0; i < t->subGroupsSize; i++)
+	if (t->subGroups[i].subGroup)
+	    *findSubGroupSlot (subGroups, size, t->subGroups[i].group,
+			       t->subGroups[i].name) = t->subGroups[i];
 
-    return pPrivate->active;
-}
+    free (t->subGroups);
+    t->subGroups = subGroups;
+    t->subGroupsSize = size;
 
+    return TRUE;
+}
 
-static void
-subGroupAdd (CCSSetting * setting, CCSGroup * group)
+/* Returns the slot of the group of setting, adding the group if it is
+   new, or NULL on failure */
+static GroupSlot *
+getGroupSlot (GroupTables *t,
+	      CCSGroupSeq *groups,
+	      CCSSetting  *setting)
 {
-    CCSSubGroupList l = group->subGroups;
-    CCSSubGroup     *subGroup;
+    GroupSlot *g;
+    CCSGroup  *group;
 
-    while (l)
-    {
-	if (!strcmp (l->data->name, setting->subGroup))
-	{
-	    l->data->settings = ccsSettingListAppend (l->data->settings,
-						      setting);
-	    return;
-	}
+    g = findGroupSlot (t->groups, t->groupsSize, setting->group);
+    if (g->group)
+	return g;
 
-	l = l->next;
+    if ((t->numGroups + 1) * 2 > t->groupsSize)
+    {
+	if (!growGroupSlots (t))
+	    return NULL;
+	g = findGroupSlot (t->groups, t->groupsSize, setting->group);
     }
 
-    subGroup = calloc (1, sizeof (CCSSubGroup));
-    if (subGroup)
+    group = calloc (1, sizeof (CCSGroup));
+    if (!group || !ccsGroupSeqAppend (groups, group))
     {
-	group->subGroups = ccsSubGroupListAppend (group->subGroups, subGroup);
-	subGroup->name = strdup (setting->subGroup);
-	subGroup->settings = ccsSettingListAppend (subGroup->settings, setting);
+	if (group)
+	    free (group);
+	return NULL;
     }
+
+    group->name = setting->group;
+    g->name = setting->group;
+    g->group = group;
+    t->numGroups++;
+
+    return g;
 }
 
-static void
-groupAdd (CCSSetting * setting, CCSPluginPrivate * p)
+static SubGroupSlot *
+getSubGroupSlot (GroupTables *t,
+		 GroupSlot   *g,
+		 CCSSetting  *setting)
 {
-    CCSGroupList l = p->groups;
-    CCSGroup     *group;
+    SubGroupSlot *sg;
+    CCSSubGroup  *subGroup;
 
-    while (l)
-    {
-	if (!strcmp (l->data->name, setting->group))
-	{
-	    subGroupAdd (setting, l->data);
-	    return;
-	}
+    sg = findSubGroupSlot (t->subGroups, t->subGroupsSize,
+			   g->group, setting->subGroup);
+    if (sg->subGroup)
+	return sg;
 
-	l = l->next;
+    if ((t->numSubGroups + 1) * 2 > t->subGroupsSize)
+    {
+	if (!growSubGroupSlots (t))
+	    return NULL;
+	sg = findSubGroupSlot (t->subGroups, t->subGroupsSize,
+			       g->group, setting->subGroup);
     }
 
-    group = calloc (1, sizeof (CCSGroup));
-    if (group)
+    subGroup = calloc (1, sizeof (CCSSubGroup));
+    if (!subGroup || !ccsSubGroupSeqAppend (&g->subGroups, subGroup))
     {
-    	p->groups = ccsGroupListAppend (p->groups, group);
-	group->name = strdup (setting->group);
-	subGroupAdd (setting, group);
+	if (subGroup)
+	    free (subGroup);
+	return NULL;
     }
+
+    subGroup->name = setting->subGroup;
+    g->group->subGroups = g->subGroups.head;
+    sg->group = g->group;
+    sg->name = setting->subGroup;
+    sg->subGroup = subGroup;
+    t->numSubGroups++;
+
+    return sg;
 }
 
-void
+/* Sorts the settings into groups and subgroups, returns FALSE if it ran
+   out of memory */
+static Bool
 collateGroups (CCSPluginPrivate * p)
 {
-    CCSSettingList l = p->settings;
+    CCSGroupSeq    groups = { NULL, NULL, 0 };
+    GroupTables    t = { NULL, 16, 0, NULL, 16, 0 };
+    CCSSettingList l;
+    Bool           collated;
 
-    while (l)
+    t.groups = calloc (t.groupsSize, sizeof (GroupSlot));
+    t.subGroups = calloc (t.subGroupsSize, sizeof (SubGroupSlot));
+    collated = t.groups && t.subGroups;
+
+    for (l = p->settings.head; l && collated; l = l->next)
     {
-	groupAdd (l->data, p);
-	l = l->next;
+	GroupSlot    *g;
+	SubGroupSlot *sg;
+
+	g = getGroupSlot (&t, &groups, l->data);
+	sg = g ? getSubGroupSlot (&t, g, l->data) : NULL;
+
+	if (!sg || !ccsSettingSeqAppend (&sg->settings, l->data))
+	{
+	    collated = FALSE;
+	    break;
+	}
+
+	sg->subGroup->settings = sg->settings.head;
     }
+
+    /* a partial list is dropped, the next call starts over */
+    if (collated)
+	p->groups = groups.head;
+    else
+	ccsGroupListFree (groups.head, TRUE);
+
+    if (t.groups)
+	free (t.groups);
+    if (t.subGroups)
+	free (t.subGroups);
+
+    return collated;
 }
 
 void
@@ -394,14 +1095,29 @@ ccsFreeContext (CCSContext * c)
     if (c->changedSettings)
 	ccsSettingListFree (c->changedSettings, FALSE);
 
+    ccsSettingSeqFree (&cPrivate->changedSettings, FALSE);
+
+    ccsSettingSeqFree (&cPrivate->pendingSettings, FALSE);
+
+    if (cPrivate->pluginIndex)
+	free (cPrivate->pluginIndex);
+
+    freePluginRelations (cPrivate);
+
+    if (cPrivate->presets)
+	ccsIniClose (cPrivate->presets);
+
     if (c->screens)
 	free (c->screens);
 
+    /* the plugins still point into the string pool */
+    ccsPluginListFree (c->plugins, TRUE);
+
+    freeStringPool (cPrivate);
+
     if (c->ccsPrivate)
 	free (c->ccsPrivate);
 
-    ccsPluginListFree (c->plugins, TRUE);
-
     free (c);
 }
 
@@ -415,22 +1131,28 @@ ccsFreePlugin (CCSPlugin * p)
     free (p->shortDesc);
     free (p->longDesc);
     free (p->hints);
-    free (p->category);
 
-    ccsStringListFree (p->loadAfter, TRUE);
-    ccsStringListFree (p->loadBefore, TRUE);
-    ccsStringListFree (p->requiresPlugin, TRUE);
-    ccsStringListFree (p->conflictPlugin, TRUE);
-    ccsStringListFree (p->conflictFeature, TRUE);
-    ccsStringListFree (p->providesFeature, TRUE);
-    ccsStringListFree (p->requiresFeature, TRUE);
+    /* category and dependencies are interned */
+    ccsStringListFree (p->loadAfter, FALSE);
+    ccsStringListFree (p->loadBefore, FALSE);
+    ccsStringListFree (p->requiresPlugin, FALSE);
+    ccsStringListFree (p->conflictPlugin, FALSE);
+    ccsStringListFree (p->conflictFeature, FALSE);
+    ccsStringListFree (p->providesFeature, FALSE);
+    ccsStringListFree (p->requiresFeature, FALSE);
 
     PLUGIN_PRIV (p);
 
-    ccsSettingListFree (pPrivate->settings, TRUE);
+    ccsSettingSeqFree (&pPrivate->settings, TRUE);
     ccsGroupListFree (pPrivate->groups, TRUE);
     ccsStrExtensionListFree (pPrivate->stringExtensions, TRUE);
 
+    if (pPrivate->settingIndex)
+	free (pPrivate->settingIndex);
+
+    if (pPrivate->iniKeyIndex)
+	free (pPrivate->iniKeyIndex);
+
     if (pPrivate->xmlFile)
 	free (pPrivate->xmlFile);
 
@@ -446,18 +1168,11 @@ ccsFreePlugin (CCSPlugin * p)
     free (p);
 }
 
-void
-ccsFreeSetting (CCSSetting * s)
+/* descriptions, groups and hints are interned */
+static void
+freeSettingMetadata (CCSSetting * s)
 {
-    if (!s)
-	return;
-
     free (s->name);
-    free (s->shortDesc);
-    free (s->longDesc);
-    free (s->group);
-    free (s->subGroup);
-    free (s->hints);
 
     switch (s->type)
     {
@@ -476,11 +1191,38 @@ ccsFreeSetting (CCSSetting * s)
     default:
 	break;
     }
+}
+
+void
+ccsFreeSetting (CCSSetting * s)
+{
+    if (!s)
+	return;
+
+    /* the metadata of other screens' instances is freed with the
+       setting it came from */
+    if (!s->ccsPrivate ||
+	!((CCSSettingPrivate *) s->ccsPrivate)->metadataOwner)
+	freeSettingMetadata (s);
 
     if (&s->defaultValue != s->value)
 	ccsFreeSettingValue (s->value);
 
     ccsFreeSettingValue (&s->defaultValue);
+
+    if (s->ccsPrivate)
+    {
+	SETTING_PRIV (s);
+
+	if (sPrivate->iniKey)
+	    free (sPrivate->iniKey);
+
+	if (sPrivate->listArray)
+	    free (sPrivate->listArray);
+
+	free (sPrivate);
+    }
+
     free (s);
 }
 
@@ -490,7 +1232,7 @@ ccsFreeGroup (CCSGroup * g)
     if (!g)
 	return;
 
-    free (g->name);
+    /* the name is interned */
     ccsSubGroupListFree (g->subGroups, TRUE);
     free (g);
 }
@@ -501,7 +1243,6 @@ ccsFreeSubGroup (CCSSubGroup * s)
     if (!s)
 	return;
 
-    free (s->name);
     ccsSettingListFree (s->settings, FALSE);
     free (s);
 }
@@ -553,6 +1294,17 @@ ccsFreePluginConflict (CCSPluginConflict * c)
     free (c);
 }
 
+void
+ccsFreePluginConflictStatus (CCSPluginConflictStatus * s)
+{
+    if (!s)
+	return;
+
+    ccsPluginConflictListFree (s->conflicts, TRUE);
+
+    free (s);
+}
+
 void
 ccsFreeBackendInfo (CCSBackendInfo * b)
 {
@@ -607,7 +1359,7 @@ ccsFreeStrExtension (CCSStrExtension *e)
     if (e->basePlugin)
 	free (e->basePlugin);
 
-    ccsStringListFree (e->baseSettings, TRUE);
+    ccsStringListFree (e->baseSettings, FALSE);
     ccsStrRestrictionListFree (e->restriction, TRUE);
 
     free (e);
@@ -666,6 +1418,9 @@ ccsSetBackend (CCSContext * context, char *name)
 	if (strcmp (cPrivate->backend->vTable->name, name) == 0)
 	    return TRUE;
 
+	/* queued settings belong to the old backend */
+	ccsFlushSettings (context);
+
 	if (cPrivate->backend->vTable->backendFini)
 	    cPrivate->backend->vTable->backendFini (context);
 
@@ -716,77 +1471,283 @@ ccsSetBackend (CCSContext * context, char *name)
 	ccsWriteConfig (OptionBackend, name);
     ccsEnableFileWatch (cPrivate->configWatchId);
 
-    return TRUE;
+    return TRUE;
+}
+
+static void
+copyValue (CCSSettingValue * from, CCSSettingValue * to)
+{
+    memcpy (to, from, sizeof (CCSSettingValue));
+    CCSSettingType type = from->parent->type;
+
+    if (from->isListChild)
+	type = from->parent->info.forList.listType;
+
+    switch (type)
+    {
+    case TypeString:
+	to->value.asString = strdup (from->value.asString);
+	break;
+    case TypeMatch:
+	to->value.asMatch = strdup (from->value.asMatch);
+	break;
+    case TypeList:
+	{
+	    CCSSettingValueSeq values = { NULL, NULL, 0 };
+	    CCSSettingValueList l = from->value.asList;
+
+	    while (l)
+	    {
+		CCSSettingValue *value = calloc (1, sizeof (CCSSettingValue));
+		if (!value)
+		    break;
+
+		copyValue (l->data, value);
+		ccsSettingValueSeqAppend (&values, value);
+		l = l->next;
+	    }
+
+	    to->value.asList = values.head;
+	}
+	break;
+    default:
+	break;
+    }
+}
+
+/* Creates the instance of a screen setting for another screen. The
+   name, descriptions, group and type info are shared with setting,
+   only the values are per screen. */
+CCSSetting *
+ccsSettingNewForScreen (CCSSetting   *setting,
+			unsigned int screenNum)
+{
+    CCSSetting        *s;
+    CCSSettingPrivate *sPrivate;
+    CCSSettingPrivate *ownerPrivate = setting->ccsPrivate;
+
+    s = malloc (sizeof (CCSSetting));
+    if (!s)
+	return NULL;
+
+    sPrivate = calloc (1, sizeof (CCSSettingPrivate));
+    if (!sPrivate)
+    {
+	free (s);
+	return NULL;
+    }
+
+    memcpy (s, setting, sizeof (CCSSetting));
+    s->ccsPrivate = sPrivate;
+    s->screenNum = screenNum;
+    s->isDefault = TRUE;
+    s->value = &s->defaultValue;
+
+    sPrivate->metadataOwner = ownerPrivate->metadataOwner ?
+			      ownerPrivate->metadataOwner : setting;
+
+    copyValue (&setting->defaultValue, &s->defaultValue);
+    s->defaultValue.parent = s;
+
+    if (s->type == TypeList)
+    {
+	CCSSettingValueList l;
+
+	for (l = s->defaultValue.value.asList; l; l = l->next)
+	    l->data->parent = s;
+    }
+
+    return s;
+}
+
+/* drops the array built by ccsGet*ListArray; every path through the API
+   that replaces the list value of a setting calls this */
+static void
+invalidateListArray (CCSSetting *setting)
+{
+    SETTING_PRIV (setting);
+
+    if (!sPrivate->listArray)
+	return;
+
+    free (sPrivate->listArray);
+    sPrivate->listArray = NULL;
+    sPrivate->listArrayLength = 0;
+}
+
+static void
+copyFromDefault (CCSSetting * setting)
+{
+    CCSSettingValue *value;
+
+    if (setting->type == TypeList)
+	invalidateListArray (setting);
+
+    if (setting->value != &setting->defaultValue)
+	ccsFreeSettingValue (setting->value);
+
+    value = calloc (1, sizeof (CCSSettingValue));
+    if (!value)
+    {
+	setting->value = &setting->defaultValue;
+	setting->isDefault = TRUE;
+	return;
+    }
+
+    copyValue (&setting->defaultValue, value);
+    setting->value = value;
+    setting->isDefault = FALSE;
+}
+
+/* The settings changed since the last write are kept in a private
+   sequence; a setting is in there if its changedEpoch matches the one of
+   the context. context->changedSettings is only rebuilt from it when it
+   is asked for, and the library never follows a node of that list
+   otherwise: callers may free, replace or take over the list at any
+   time. If it is not the list published last, the list found in the
+   context is adopted. */
+static void
+adoptChangedSettings (CCSContext *context)
+{
+    CCSSettingList l;
+
+    CONTEXT_PRIV (context);
+
+    ccsSettingSeqFree (&cPrivate->changedSettings, FALSE);
+    cPrivate->changedEpoch++;
+
+    for (l = context->changedSettings; l; l = l->next)
+    {
+	SETTING_PRIV (l->data);
+
+	if (sPrivate->changedEpoch == cPrivate->changedEpoch)
+	    continue;
+
+	if (ccsSettingSeqAppend (&cPrivate->changedSettings, l->data))
+	    sPrivate->changedEpoch = cPrivate->changedEpoch;
+    }
+
+    cPrivate->publishedChanged = context->changedSettings;
+    cPrivate->changedStale = FALSE;
+}
+
+static void
+markSettingChanged (CCSSetting *setting)
+{
+    CCSContext *context = setting->parent->context;
+
+    CONTEXT_PRIV (context);
+    SETTING_PRIV (setting);
+
+    if (context->changedSettings != cPrivate->publishedChanged)
+	adoptChangedSettings (context);
+
+    if (sPrivate->changedEpoch == cPrivate->changedEpoch)
+	return;
+
+    if (!ccsSettingSeqAppend (&cPrivate->changedSettings, setting))
+	return;
+
+    sPrivate->changedEpoch = cPrivate->changedEpoch;
+    cPrivate->changedStale = TRUE;
+}
+
+/* Returns the settings to write: the private sequence plus whatever
+   callers added to the public list in place */
+static CCSSettingList
+collectChangedSettings (CCSContext *context)
+{
+    CCSSettingList l;
+
+    CONTEXT_PRIV (context);
+
+    if (context->changedSettings != cPrivate->publishedChanged)
+    {
+	adoptChangedSettings (context);
+	return cPrivate->changedSettings.head;
+    }
+
+    for (l = context->changedSettings; l; l = l->next)
+    {
+	SETTING_PRIV (l->data);
+
+	if (sPrivate->changedEpoch == cPrivate->changedEpoch)
+	    continue;
+
+	if (ccsSettingSeqAppend (&cPrivate->changedSettings, l->data))
+	    sPrivate->changedEpoch = cPrivate->changedEpoch;
+    }
+
+    return cPrivate->changedSettings.head;
 }
 
+/* Rebuilds context->changedSettings from the private sequence, in the
+   order the settings were changed. The old list is kept if the new one
+   can't be allocated. */
 static void
-copyValue (CCSSettingValue * from, CCSSettingValue * to)
+publishChangedSettings (CCSContext *context)
 {
-    memcpy (to, from, sizeof (CCSSettingValue));
-    CCSSettingType type = from->parent->type;
+    CCSSettingSeq  list = { NULL, NULL, 0 };
+    CCSSettingList l;
 
-    if (from->isListChild)
-	type = from->parent->info.forList.listType;
+    CONTEXT_PRIV (context);
 
-    switch (type)
-    {
-    case TypeString:
-	to->value.asString = strdup (from->value.asString);
-	break;
-    case TypeMatch:
-	to->value.asMatch = strdup (from->value.asMatch);
-	break;
-    case TypeList:
-	to->value.asList = NULL;
-	CCSSettingValueList l = from->value.asList;
-	while (l)
-	{
-	    CCSSettingValue *value = calloc (1, sizeof (CCSSettingValue));
-	    if (!value)
-		break;
+    collectChangedSettings (context);
 
-	    copyValue (l->data, value);
-	    to->value.asList = ccsSettingValueListAppend (to->value.asList,
-							  value);
-	    l = l->next;
+    if (!cPrivate->changedStale)
+	return;
+
+    for (l = cPrivate->changedSettings.head; l; l = l->next)
+	if (!ccsSettingSeqAppend (&list, l->data))
+	{
+	    ccsSettingSeqFree (&list, FALSE);
+	    return;
 	}
-	break;
-    default:
-	break;
-    }
+
+    ccsSettingListFree (context->changedSettings, FALSE);
+    context->changedSettings = cPrivate->publishedChanged = list.head;
+    cPrivate->changedStale = FALSE;
 }
 
 static void
-copyFromDefault (CCSSetting * setting)
+clearChangedSettings (CCSContext *context)
 {
-    CCSSettingValue *value;
+    CONTEXT_PRIV (context);
 
-    if (setting->value != &setting->defaultValue)
-	ccsFreeSettingValue (setting->value);
+    context->changedSettings =
+	ccsSettingListFree (context->changedSettings, FALSE);
 
-    value = calloc (1, sizeof (CCSSettingValue));
-    if (!value)
+    ccsSettingSeqFree (&cPrivate->changedSettings, FALSE);
+    cPrivate->publishedChanged = NULL;
+    cPrivate->changedStale = FALSE;
+    cPrivate->changedEpoch++;
+}
+
+static void
+clearPendingSettings (CCSContextPrivate *cPrivate)
+{
+    CCSSettingList l;
+
+    for (l = cPrivate->pendingSettings.head; l; l = l->next)
     {
-	setting->value = &setting->defaultValue;
-	setting->isDefault = TRUE;
-	return;
+	SETTING_PRIV (l->data);
+	sPrivate->pending = FALSE;
     }
 
-    copyValue (&setting->defaultValue, value);
-    setting->value = value;
-    setting->isDefault = FALSE;
+    ccsSettingSeqFree (&cPrivate->pendingSettings, FALSE);
 }
 
 void
 ccsResetToDefault (CCSSetting * setting)
 {
+    if (setting->type == TypeList)
+	invalidateListArray (setting);
+
     if (setting->value != &setting->defaultValue)
     {
 	ccsFreeSettingValue (setting->value);
 
-    	setting->parent->context->changedSettings =
-	    ccsSettingListAppend (setting->parent->context->changedSettings,
-				  setting);
+	markSettingChanged (setting);
     }
 
     setting->value = &setting->defaultValue;
@@ -827,9 +1788,7 @@ ccsSetInt (CCSSetting * setting, int data)
 
     setting->value->value.asInt = data;
 
-    setting->parent->context->changedSettings =
-	ccsSettingListAppend (setting->parent->context->changedSettings,
-			      setting);
+    markSettingChanged (setting);
 
     return TRUE;
 }
@@ -863,9 +1822,7 @@ ccsSetFloat (CCSSetting * setting, float data)
 
     setting->value->value.asFloat = data;
 
-    setting->parent->context->changedSettings =
-	ccsSettingListAppend (setting->parent->context->changedSettings,
-			      setting);
+    markSettingChanged (setting);
 
     return TRUE;
 }
@@ -898,9 +1855,7 @@ ccsSetBool (CCSSetting * setting, Bool data)
 
     setting->value->value.asBool = data;
 
-    setting->parent->context->changedSettings =
-	ccsSettingListAppend (setting->parent->context->changedSettings,
-			      setting);
+    markSettingChanged (setting);
 
     return TRUE;
 }
@@ -935,9 +1890,7 @@ ccsSetString (CCSSetting * setting, const char *data)
 
     setting->value->value.asString = strdup (data);
 
-    setting->parent->context->changedSettings =
-	ccsSettingListAppend (setting->parent->context->changedSettings,
-			      setting);
+    markSettingChanged (setting);
 
     return TRUE;
 }
@@ -969,9 +1922,7 @@ ccsSetColor (CCSSetting * setting, CCSSettingColorValue data)
 
     setting->value->value.asColor = data;
 
-    setting->parent->context->changedSettings =
-	ccsSettingListAppend (setting->parent->context->changedSettings,
-			      setting);
+    markSettingChanged (setting);
 
     return TRUE;
 }
@@ -1006,9 +1957,7 @@ ccsSetMatch (CCSSetting * setting, const char *data)
 
     setting->value->value.asMatch = strdup (data);
 
-    setting->parent->context->changedSettings =
-	ccsSettingListAppend (setting->parent->context->changedSettings,
-			      setting);
+    markSettingChanged (setting);
 
     return TRUE;
 }
@@ -1041,9 +1990,7 @@ ccsSetKey (CCSSetting * setting, CCSSettingKeyValue data)
     setting->value->value.asKey.keysym = data.keysym;
     setting->value->value.asKey.keyModMask = data.keyModMask;
 
-    setting->parent->context->changedSettings =
-	ccsSettingListAppend (setting->parent->context->changedSettings,
-			      setting);
+    markSettingChanged (setting);
 
     return TRUE;
 }
@@ -1077,9 +2024,7 @@ ccsSetButton (CCSSetting * setting, CCSSettingButtonValue data)
     setting->value->value.asButton.buttonModMask = data.buttonModMask;
     setting->value->value.asButton.edgeMask = data.edgeMask;
 
-    setting->parent->context->changedSettings =
-	ccsSettingListAppend (setting->parent->context->changedSettings,
-			      setting);
+    markSettingChanged (setting);
 
     return TRUE;
 }
@@ -1109,9 +2054,7 @@ ccsSetEdge (CCSSetting * setting, unsigned int data)
 
     setting->value->value.asEdge = data;
 
-    setting->parent->context->changedSettings =
-	ccsSettingListAppend (setting->parent->context->changedSettings,
-			      setting);
+    markSettingChanged (setting);
 
     return TRUE;
 }
@@ -1141,9 +2084,7 @@ ccsSetBell (CCSSetting * setting, Bool data)
 
     setting->value->value.asBell = data;
 
-    setting->parent->context->changedSettings =
-	ccsSettingListAppend (setting->parent->context->changedSettings,
-			      setting);
+    markSettingChanged (setting);
 
     return TRUE;
 }
@@ -1217,13 +2158,13 @@ ccsCompareLists (CCSSettingValueList l1, CCSSettingValueList l2,
 static CCSSettingValueList
 ccsCopyList (CCSSettingValueList l1, CCSSetting * setting)
 {
-    CCSSettingValueList l2 = NULL;
+    CCSSettingValueSeq l2 = { NULL, NULL, 0 };
 
     while (l1)
     {
 	CCSSettingValue *value = calloc (1, sizeof (CCSSettingValue));
 	if (!value)
-	    return l2;
+	    return l2.head;
 
 	value->parent = setting;
 	value->isListChild = TRUE;
@@ -1270,11 +2211,11 @@ ccsCopyList (CCSSettingValueList l1, CCSSetting * setting)
 	    break;
 	}
 
-	l2 = ccsSettingValueListAppend (l2, value);
+	ccsSettingValueSeqAppend (&l2, value);
 	l1 = l1->next;
     }
 
-    return l2;
+    return l2.head;
 }
 
 Bool
@@ -1302,6 +2243,7 @@ ccsSetList (CCSSetting * setting, CCSSettingValueList data)
     if (setting->isDefault)
 	copyFromDefault (setting);
 
+    invalidateListArray (setting);
     ccsSettingValueListFree (setting->value->value.asList, TRUE);
 
     setting->value->value.asList = ccsCopyList (data, setting);
@@ -1316,9 +2258,7 @@ ccsSetList (CCSSetting * setting, CCSSettingValueList data)
 	ccsStringListFree (list, TRUE);
     }
 
-    setting->parent->context->changedSettings =
-	ccsSettingListAppend (setting->parent->context->changedSettings,
-			      setting);
+    markSettingChanged (setting);
 
     return TRUE;
 }
@@ -1477,6 +2417,136 @@ ccsGetList (CCSSetting * setting, CCSSettingValueList * data)
     return TRUE;
 }
 
+/* Copies the list value of setting into an array of type listType,
+   which stays cached in the setting until the list is replaced */
+static void *
+getListArray (CCSSetting     *setting,
+	      CCSSettingType listType,
+	      int            *num)
+{
+    CCSSettingValueList list, l;
+    size_t              size;
+    void                *array;
+    int                 i, n;
+
+    *num = 0;
+
+    if (setting->type != TypeList ||
+	setting->info.forList.listType != listType)
+	return NULL;
+
+    SETTING_PRIV (setting);
+
+    list = setting->value->value.asList;
+
+    if (sPrivate->listArray)
+    {
+	*num = sPrivate->listArrayLength;
+	return sPrivate->listArray;
+    }
+
+    invalidateListArray (setting);
+
+    n = ccsSettingValueListLength (list);
+    if (!n)
+	return NULL;
+
+    switch (listType)
+    {
+    case TypeInt:
+	size = sizeof (int);
+	break;
+    case TypeFloat:
+	size = sizeof (float);
+	break;
+    case TypeBool:
+	size = sizeof (Bool);
+	break;
+    case TypeColor:
+	size = sizeof (CCSSettingColorValue);
+	break;
+    case TypeString:
+    case TypeMatch:
+	size = sizeof (char *);
+	break;
+    default:
+	return NULL;
+    }
+
+    array = malloc (n * size);
+    if (!array)
+	return NULL;
+
+    for (i = 0, l = list; l; i++, l = l->next)
+    {
+	switch (listType)
+	{
+	case TypeInt:
+	    ((int *) array)[i] = l->data->value.asInt;
+	    break;
+	case TypeFloat:
+	    ((float *) array)[i] = l->data->value.asFloat;
+	    break;
+	case TypeBool:
+	    ((Bool *) array)[i] = l->data->value.asBool;
+	    break;
+	case TypeColor:
+	    ((CCSSettingColorValue *) array)[i] = l->data->value.asColor;
+	    break;
+	case TypeString:
+	    ((char **) array)[i] = l->data->value.asString;
+	    break;
+	case TypeMatch:
+	    ((char **) array)[i] = l->data->value.asMatch;
+	    break;
+	default:
+	    break;
+	}
+    }
+
+    sPrivate->listArray       = array;
+    sPrivate->listArrayLength = n;
+
+    *num = n;
+    return array;
+}
+
+const int *
+ccsGetIntListArray (CCSSetting *setting, int *num)
+{
+    return getListArray (setting, TypeInt, num);
+}
+
+const float *
+ccsGetFloatListArray (CCSSetting *setting, int *num)
+{
+    return getListArray (setting, TypeFloat, num);
+}
+
+const Bool *
+ccsGetBoolListArray (CCSSetting *setting, int *num)
+{
+    return getListArray (setting, TypeBool, num);
+}
+
+const CCSSettingColorValue *
+ccsGetColorListArray (CCSSetting *setting, int *num)
+{
+    return getListArray (setting, TypeColor, num);
+}
+
+const char * const *
+ccsGetStringListArray (CCSSetting *setting, int *num)
+{
+    return getListArray (setting, TypeString, num);
+}
+
+const char * const *
+ccsGetMatchListArray (CCSSetting *setting, int *num)
+{
+    return getListArray (setting, TypeMatch, num);
+}
+
 void
 ccsContextDestroy (CCSContext * context)
 {
@@ -1485,6 +2555,8 @@ ccsContextDestroy (CCSContext * context)
 
     CONTEXT_PRIV (context);
 
+    ccsFlushSettings (context);
+
     if (cPrivate->backend)
     {
 	if (cPrivate->backend->vTable->backendFini)
@@ -1501,7 +2573,7 @@ ccsContextDestroy (CCSContext * context)
 CCSPluginList
 ccsGetActivePluginList (CCSContext * context)
 {
-    CCSPluginList rv = NULL;
+    CCSPluginSeq  rv = { NULL, NULL, 0 };
     CCSPluginList l = context->plugins;
 
     while (l)
@@ -1509,13 +2581,13 @@ ccsGetActivePluginList (CCSContext * context)
 	PLUGIN_PRIV (l->data);
 	if (pPrivate->active && strcmp (l->data->name, "ccp"))
 	{
-	    rv = ccsPluginListAppend (rv, l->data);
+	    ccsPluginSeqAppend (&rv, l->data);
 	}
 
 	l = l->next;
     }
 
-    return rv;
+    return rv.head;
 }
 
 static CCSPlugin *
@@ -1538,153 +2610,347 @@ findPluginInList (CCSPluginList list, char *name)
 typedef struct _PluginSortHelper
 {
     CCSPlugin *plugin;
-    CCSPluginList after;
+    int       inDegree;  /* unsorted plugins that have to load first */
+    int       firstEdge; /* plugins to load after this one are */
+    int       nEdges;    /* edges[firstEdge .. firstEdge + nEdges - 1] */
+    Bool      sorted;
 } PluginSortHelper;
 
-CCSStringList
-ccsGetSortedPluginStringList (CCSContext * context)
+typedef struct _PluginSortRelation
 {
-    CCSPluginList ap = ccsGetActivePluginList (context);
-    CCSPluginList list;
-    CCSPlugin *p = NULL;
-    CCSStringList rv = ccsStringListAppend (NULL, strdup ("core"));
-    PluginSortHelper *ph = NULL;
+    int before;
+    int after;
+} PluginSortRelation;
 
-    p = findPluginInList (ap, "core");
-    if (p)
-	ap = ccsPluginListRemove (ap, p, FALSE);
+typedef struct _PluginSortGraph
+{
+    PluginSortHelper   *plugins;
+    int                len;
+    int                *names; /* plugin index + 1, hashed by name */
+    unsigned int       namesMask;
+    PluginSortRelation *relations;
+    int                nRelations;
+    int                relationsSize;
+    int                *edges;
+} PluginSortGraph;
+
+static int
+findSortIndex (PluginSortGraph *g, const char *name)
+{
+    unsigned int i;
+
+    if (!name || !*name)
+	return -1;
 
-    int len = ccsPluginListLength (ap);
-    if (len == 0)
+    for (i = iniparser_hash ((char *) name) & g->namesMask; g->names[i];
+	 i = (i + 1) & g->namesMask)
     {
-	ccsStringListFree (rv, TRUE);
-	return NULL;
+	if (!strcmp (g->plugins[g->names[i] - 1].plugin->name, name))
+	    return g->names[i] - 1;
     }
-    int i, j;
-    /* TODO: conflict handling */
 
-    PluginSortHelper *plugins = calloc (1, len * sizeof (PluginSortHelper));
-    if (!plugins)
+    return -1;
+}
+
+static Bool
+addSortRelation (PluginSortGraph *g, int before, int after)
+{
+    if (g->nRelations == g->relationsSize)
     {
-	ccsStringListFree (rv, TRUE);
-	return NULL;
+	int                size = g->relationsSize ? g->relationsSize * 2 : 64;
+	PluginSortRelation *r;
+
+	r = realloc (g->relations, size * sizeof (PluginSortRelation));
+	if (!r)
+	    return FALSE;
+
+	g->relations = r;
+	g->relationsSize = size;
     }
 
-    for (i = 0, list = ap; i < len; i++, list = list->next)
+    g->relations[g->nRelations].before = before;
+    g->relations[g->nRelations].after = after;
+    g->nRelations++;
+
+    g->plugins[before].nEdges++;
+    g->plugins[after].inDegree++;
+
+    return TRUE;
+}
+
+static void
+sortHeapPush (int *heap, int *n, int v)
+{
+    int i = (*n)++;
+
+    while (i && heap[(i - 1) / 2] > v)
     {
-	plugins[i].plugin = list->data;
-	plugins[i].after = NULL;
+	heap[i] = heap[(i - 1) / 2];
+	i = (i - 1) / 2;
     }
 
-    for (i = 0; i < len; i++)
+    heap[i] = v;
+}
+
+static int
+sortHeapPop (int *heap, int *n)
+{
+    int top = heap[0];
+    int v = heap[--(*n)];
+    int i = 0, c;
+
+    while ((c = 2 * i + 1) < *n)
     {
-	CCSStringList l = plugins[i].plugin->loadAfter;
-	while (l)
-	{
-	    p = findPluginInList (ap, l->data);
+	if (c + 1 < *n && heap[c + 1] < heap[c])
+	    c++;
+	if (heap[c] >= v)
+	    break;
+
+	heap[i] = heap[c];
+	i = c;
+    }
 
-	    if (p && !ccsPluginListFind (plugins[i].after, p))
-		plugins[i].after = ccsPluginListAppend (plugins[i].after, p);
+    heap[i] = v;
 
-	    l = l->next;
-	}
+    return top;
+}
 
-	l = plugins[i].plugin->requiresPlugin;
-	while (l)
-	{
-	    Bool found = FALSE;
-	    p = findPluginInList (ap, l->data);
+/* Every unsorted plugin with a non-zero in-degree waits for another one
+   of those, unless all it waits for is bench, so walking backwards from
+   one of them along such relations runs into a cycle */
+static void
+reportSortFailure (PluginSortGraph *g)
+{
+    int *path = malloc (2 * g->len * sizeof (int));
+    int *step = path + g->len;
+    int i, n = 0, cur = -1;
 
-	    CCSStringList l2 = plugins[i].plugin->loadBefore;
-	    while (l2)
-	    {
-		if (strcmp (l2->data, l->data) == 0)
-		    found = TRUE;
-		l2 = l2->next;
-	    }
-	    
-	    if (p && !ccsPluginListFind (plugins[i].after, p) && !found)
-		plugins[i].after = ccsPluginListAppend (plugins[i].after, p);
+    if (!path)
+    {
+	fprintf (stderr, "libccs: unable to generate sorted plugin list\n");
+	return;
+    }
 
-	    l = l->next;
-	}
+    for (i = 0; i < g->len; i++)
+    {
+	step[i] = -1;
+	if (cur < 0 && !g->plugins[i].sorted && g->plugins[i].inDegree)
+	    cur = i;
+    }
 
-	l = plugins[i].plugin->loadBefore;
-	while (l)
-	{
-	    p = findPluginInList (ap, l->data);
+    while (cur >= 0 && step[cur] < 0)
+    {
+	int pred = -1;
 
-	    if (p)
-	    {
-		ph = NULL;
+	step[cur] = n;
+	path[n++] = cur;
 
-		for (j = 0; j < len; j++)
-		    if (p == plugins[j].plugin)
-			ph = &plugins[j];
+	for (i = 0; i < g->nRelations && pred < 0; i++)
+	{
+	    PluginSortRelation *r = &g->relations[i];
 
-		if (ph && !ccsPluginListFind (ph->after, plugins[i].plugin))
-		    ph->after = ccsPluginListAppend (ph->after,
-						     plugins[i].plugin);
-	    }
+	    if (r->after == cur && !g->plugins[r->before].sorted &&
+		g->plugins[r->before].inDegree)
+		pred = r->before;
+	}
 
-	    l = l->next;
+	if (pred < 0)
+	{
+	    fprintf (stderr, "libccs: unable to generate sorted plugin list, "
+		     "%s has to load after bench\n",
+		     g->plugins[cur].plugin->name);
+	    free (path);
+	    return;
 	}
+
+	cur = pred;
     }
 
-    ccsPluginListFree (ap, FALSE);
+    if (cur < 0)
+    {
+	fprintf (stderr, "libccs: unable to generate sorted plugin list\n");
+	free (path);
+	return;
+    }
+
+    /* the path runs backwards, print the cycle in load order */
+    fprintf (stderr, "libccs: unable to generate sorted plugin list, "
+	     "load order cycle: %s", g->plugins[cur].plugin->name);
+    for (i = n - 1; i >= step[cur]; i--)
+	fprintf (stderr, " -> %s", g->plugins[path[i]].plugin->name);
+    fprintf (stderr, "\n");
+
+    free (path);
+}
+
+CCSStringList
+ccsGetSortedPluginStringList (CCSContext * context)
+{
+    CCSPluginList   ap = ccsGetActivePluginList (context);
+    CCSPluginList   list;
+    CCSPlugin       *p = NULL;
+    CCSStringList   rv = NULL, l, l2;
+    PluginSortGraph g;
+    int             *ready, *next, *order;
+    int             nReady = 0, nNext = 0, removed = 0;
+    int             i, j, bench;
+    unsigned int    size;
+    Bool            ok;
+
+    p = findPluginInList (ap, "core");
+    if (p)
+	ap = ccsPluginListRemove (ap, p, FALSE);
+
+    memset (&g, 0, sizeof (PluginSortGraph));
 
-    Bool error = FALSE;
-    int removed = 0;
-    Bool found;
+    g.len = ccsPluginListLength (ap);
+    if (g.len == 0)
+	return NULL;
+
+    /* TODO: conflict handling */
+
+    for (size = 16; size < 2 * g.len; size *= 2);
 
-    while (!error && removed < len)
+    g.plugins = calloc (g.len, sizeof (PluginSortHelper));
+    g.names = calloc (size, sizeof (int));
+    g.namesMask = size - 1;
+    ready = malloc (3 * g.len * sizeof (int));
+    next = ready + g.len;
+    order = next + g.len;
+
+    ok = g.plugins && g.names && ready;
+
+    for (i = 0, list = ap; ok && i < g.len; i++, list = list->next)
     {
-	found = FALSE;
+	g.plugins[i].plugin = list->data;
 
-	for (i = 0; i < len; i++)
+	for (j = iniparser_hash (list->data->name) & g.namesMask; g.names[j];
+	     j = (j + 1) & g.namesMask)
 	{
-	    if (!plugins[i].plugin)
-		continue;
-	    if (plugins[i].after)
-		continue;
+	    if (!strcmp (g.plugins[g.names[j] - 1].plugin->name,
+			 list->data->name))
+		break;
+	}
 
-	    /* This is a special case to ensure that bench is the last plugin */
-	    if (len - removed > 1 &&
-		strcmp (plugins[i].plugin->name, "bench") == 0)
-		continue;
+	if (!g.names[j])
+	    g.names[j] = i + 1;
+    }
 
-	    found = TRUE;
-	    removed++;
-	    p = plugins[i].plugin;
-	    plugins[i].plugin = NULL;
+    ccsPluginListFree (ap, FALSE);
+
+    for (i = 0; ok && i < g.len; i++)
+    {
+	p = g.plugins[i].plugin;
 
-	    for (j = 0; j < len; j++)
-		plugins[j].after =
-		    ccsPluginListRemove (plugins[j].after, p, FALSE);
+	for (l = p->loadAfter; ok && l; l = l->next)
+	    if ((j = findSortIndex (&g, l->data)) >= 0)
+		ok = addSortRelation (&g, j, i);
 
-	    rv = ccsStringListAppend (rv, strdup (p->name));
+	for (l = p->requiresPlugin; ok && l; l = l->next)
+	{
+	    for (l2 = p->loadBefore; l2; l2 = l2->next)
+		if (!strcmp (l2->data, l->data))
+		    break;
+
+	    if (!l2 && (j = findSortIndex (&g, l->data)) >= 0)
+		ok = addSortRelation (&g, j, i);
 	}
 
-	if (!found)
-	    error = TRUE;
+	for (l = p->loadBefore; ok && l; l = l->next)
+	    if ((j = findSortIndex (&g, l->data)) >= 0)
+		ok = addSortRelation (&g, i, j);
+    }
+
+    if (ok)
+    {
+	g.edges = malloc ((g.nRelations ? g.nRelations : 1) * sizeof (int));
+	ok = g.edges != NULL;
     }
 
-    if (error)
+    if (ok)
     {
-	fprintf (stderr,
-		 "libccs: unable to generate sorted plugin list\n");
+	for (i = 0, j = 0; i < g.len; i++)
+	{
+	    g.plugins[i].firstEdge = j;
+	    j += g.plugins[i].nEdges;
+	    g.plugins[i].nEdges = 0;
+	}
 
-	for (i = 0; i < len; i++)
+	for (i = 0; i < g.nRelations; i++)
 	{
-	    ccsPluginListFree (plugins[i].after, FALSE);
+	    PluginSortHelper *h = &g.plugins[g.relations[i].before];
+
+	    g.edges[h->firstEdge + h->nEdges++] = g.relations[i].after;
+	}
+
+	/* Plugins are emitted in passes over the list, as the old repeated
+	   scans did: one that becomes ready through a plugin at a lower
+	   index is still picked up in the same pass, otherwise it waits
+	   for the next one.  bench is held back until it is the last. */
+	bench = findSortIndex (&g, "bench");
+
+	for (i = 0; i < g.len; i++)
+	    if (!g.plugins[i].inDegree && i != bench)
+		sortHeapPush (ready, &nReady, i);
+
+	while (nReady || nNext)
+	{
+	    PluginSortHelper *h;
+
+	    if (!nReady)
+	    {
+		while (nNext)
+		    sortHeapPush (ready, &nReady, next[--nNext]);
+	    }
+
+	    i = sortHeapPop (ready, &nReady);
+	    h = &g.plugins[i];
+
+	    h->sorted = TRUE;
+	    order[removed++] = i;
+
+	    for (j = h->firstEdge; j < h->firstEdge + h->nEdges; j++)
+	    {
+		int s = g.edges[j];
+
+		if (--g.plugins[s].inDegree || s == bench)
+		    continue;
+
+		if (s > i)
+		    sortHeapPush (ready, &nReady, s);
+		else
+		    next[nNext++] = s;
+	    }
 	}
 
-	ccsStringListFree (rv, TRUE);
+	if (removed == g.len - 1 && bench >= 0 && !g.plugins[bench].inDegree)
+	{
+	    g.plugins[bench].sorted = TRUE;
+	    order[removed++] = bench;
+	}
+
+	if (removed == g.len)
+	{
+	    for (i = g.len - 1; i >= 0; i--)
+		rv = ccsStringListPrepend (rv,
+			strdup (g.plugins[order[i]].plugin->name));
 
-	rv = NULL;
+	    rv = ccsStringListPrepend (rv, strdup ("core"));
+	}
+	else
+	    reportSortFailure (&g);
     }
 
-    free (plugins);
+    if (g.plugins)
+	free (g.plugins);
+    if (g.names)
+	free (g.names);
+    if (g.relations)
+	free (g.relations);
+    if (g.edges)
+	free (g.edges);
+    if (ready)
+	free (ready);
 
     return rv;
 }
@@ -1811,14 +3077,32 @@ ccsSetProfile (CCSContext * context, char *name)
     if (cPrivate->profile && (strcmp (cPrivate->profile, name) == 0))
 	return;
 
+    /* queued settings belong to the old profile */
+    ccsFlushSettings (context);
+
     if (cPrivate->profile)
 	free (cPrivate->profile);
 
-    cPrivate->profile = strdup (name);
+    cPrivate->profile = strdup (name);
+
+    ccsDisableFileWatch (cPrivate->configWatchId);
+    ccsWriteConfig (OptionProfile, cPrivate->profile);
+    ccsEnableFileWatch (cPrivate->configWatchId);
+}
+
+static Bool
+writeDelayElapsed (CCSContextPrivate *cPrivate)
+{
+    struct timeval now;
+    long           elapsed;
+
+    gettimeofday (&now, NULL);
 
-    ccsDisableFileWatch (cPrivate->configWatchId);
-    ccsWriteConfig (OptionProfile, cPrivate->profile);
-    ccsEnableFileWatch (cPrivate->configWatchId);
+    elapsed = (now.tv_sec - cPrivate->pendingSince.tv_sec) * 1000 +
+	      (now.tv_usec - cPrivate->pendingSince.tv_usec) / 1000;
+
+    /* also flush if the clock went backwards */
+    return elapsed < 0 || elapsed >= (long) cPrivate->writeDelay;
 }
 
 void
@@ -1831,8 +3115,13 @@ ccsProcessEvents (CCSContext * context, unsigned int flags)
 
     ccsCheckFileWatches ();
 
+    if (cPrivate->pendingSettings.head && writeDelayElapsed (cPrivate))
+	ccsFlushSettings (context);
+
     if (cPrivate->backend && cPrivate->backend->vTable->executeEvents)
 	(*cPrivate->backend->vTable->executeEvents) (flags);
+
+    publishChangedSettings (context);
 }
 
 void
@@ -1857,7 +3146,7 @@ ccsReadSettings (CCSContext * context)
     while (pl)
     {
 	PLUGIN_PRIV (pl->data);
-	CCSSettingList sl = pPrivate->settings;
+	CCSSettingList sl = pPrivate->settings.head;
 
 	while (sl)
 	{
@@ -1870,6 +3159,8 @@ ccsReadSettings (CCSContext * context)
 
     if (cPrivate->backend->vTable->readDone)
 	(*cPrivate->backend->vTable->readDone) (context);
+
+    publishChangedSettings (context);
 }
 
 void
@@ -1892,7 +3183,7 @@ ccsReadPluginSettings (CCSPlugin * plugin)
 
     PLUGIN_PRIV (plugin);
 
-    CCSSettingList sl = pPrivate->settings;
+    CCSSettingList sl = pPrivate->settings.head;
     while (sl)
     {
 	(*cPrivate->backend->vTable->readSetting) (plugin->context, sl->data);
@@ -1901,6 +3192,8 @@ ccsReadPluginSettings (CCSPlugin * plugin)
 
     if (cPrivate->backend->vTable->readDone)
 	(*cPrivate->backend->vTable->readDone) (plugin->context);
+
+    publishChangedSettings (plugin->context);
 }
 
 void
@@ -1925,7 +3218,7 @@ ccsWriteSettings (CCSContext * context)
     while (pl)
     {
 	PLUGIN_PRIV (pl->data);
-	CCSSettingList sl = pPrivate->settings;
+	CCSSettingList sl = pPrivate->settings.head;
 
 	while (sl)
 	{
@@ -1939,44 +3232,129 @@ ccsWriteSettings (CCSContext * context)
     if (cPrivate->backend->vTable->writeDone)
 	(*cPrivate->backend->vTable->writeDone) (context);
 
-    context->changedSettings =
-	ccsSettingListFree (context->changedSettings, FALSE);
+    clearChangedSettings (context);
+
+    /* everything queued has just been written as well */
+    clearPendingSettings (cPrivate);
 }
 
-void
-ccsWriteChangedSettings (CCSContext * context)
+/* Writes the given settings through the backend, returns FALSE if the
+   backend could not write anything */
+static Bool
+writeSettingList (CCSContext     *context,
+		  CCSSettingList list)
 {
-    if (!context)
-	return;
-    
     CONTEXT_PRIV (context);
-    
+
     if (!cPrivate->backend)
-	return;
+	return FALSE;
 
     if (!cPrivate->backend->vTable->writeSetting)
-	return;
+	return FALSE;
 
     if (cPrivate->backend->vTable->writeInit)
 	if (!(*cPrivate->backend->vTable->writeInit) (context))
-	    return;
+	    return FALSE;
+
+    while (list)
+    {
+	(*cPrivate->backend->vTable->writeSetting) (context, list->data);
+	list = list->next;
+    }
+
+    if (cPrivate->backend->vTable->writeDone)
+	(*cPrivate->backend->vTable->writeDone) (context);
+
+    return TRUE;
+}
+
+CCSSettingList
+ccsGetChangedSettings (CCSContext *context)
+{
+    if (!context)
+	return NULL;
+
+    publishChangedSettings (context);
+
+    return context->changedSettings;
+}
+
+void
+ccsWriteChangedSettings (CCSContext * context)
+{
+    if (!context)
+	return;
+    
+    CONTEXT_PRIV (context);
 
-    if (ccsSettingListLength (context->changedSettings))
+    if (cPrivate->deferWrites)
     {
-	CCSSettingList l = context->changedSettings;
+	CCSSettingList l;
+
+	if (!cPrivate->pendingSettings.head)
+	    gettimeofday (&cPrivate->pendingSince, NULL);
+
+	for (l = collectChangedSettings (context); l; l = l->next)
+	{
+	    SETTING_PRIV (l->data);
+
+	    if (sPrivate->pending)
+		continue;
+
+	    if (ccsSettingSeqAppend (&cPrivate->pendingSettings, l->data))
+		sPrivate->pending = TRUE;
+	}
+
+	clearChangedSettings (context);
 
-	while (l)
+	if ((cPrivate->writeThreshold &&
+	     ccsSettingSeqLength (&cPrivate->pendingSettings) >=
+	     cPrivate->writeThreshold) ||
+	    writeDelayElapsed (cPrivate))
 	{
-	    (*cPrivate->backend->vTable->writeSetting) (context, l->data);
-	    l = l->next;
+	    ccsFlushSettings (context);
 	}
+
+	return;
     }
 
-    if (cPrivate->backend->vTable->writeDone)
-	(*cPrivate->backend->vTable->writeDone) (context);
+    if (writeSettingList (context, collectChangedSettings (context)))
+	clearChangedSettings (context);
+}
 
-    context->changedSettings =
-	ccsSettingListFree (context->changedSettings, FALSE);
+void
+ccsFlushSettings (CCSContext *context)
+{
+    if (!context)
+	return;
+
+    CONTEXT_PRIV (context);
+
+    if (!cPrivate->pendingSettings.head)
+	return;
+
+    /* keep the queue if the backend can't write it now */
+    if (writeSettingList (context, cPrivate->pendingSettings.head))
+	clearPendingSettings (cPrivate);
+}
+
+void
+ccsSetDeferredWrites (CCSContext   *context,
+		      Bool         enable,
+		      unsigned int delay,
+		      unsigned int threshold)
+{
+    if (!context)
+	return;
+
+    CONTEXT_PRIV (context);
+
+    cPrivate->deferWrites    = enable;
+    cPrivate->writeDelay     = delay;
+    cPrivate->writeThreshold = threshold;
+
+    if (!enable)
+	ccsFlushSettings (context);
 }
 
 Bool
@@ -2019,10 +3397,9 @@ ccsPluginSetActive (CCSPlugin * plugin, Bool value)
     if (!plugin)
 	return FALSE;
 
-    PLUGIN_PRIV (plugin);
     CONTEXT_PRIV (plugin->context);
 
-    pPrivate->active = value;
+    setPluginActive (plugin, value);
 
     if (cPrivate->pluginListAutoSort)
 	ccsWriteAutoSortedPluginList (plugin->context);
@@ -2030,11 +3407,47 @@ ccsPluginSetActive (CCSPlugin * plugin, Bool value)
     return TRUE;
 }
 
+/* Returns a conflict of the given type listing the active plugins that
+   provide a feature, or NULL if there are none */
+static CCSPluginConflict *
+activeProvidersConflict (CCSContext            *context,
+			 const char            *feature,
+			 CCSPluginConflictType type)
+{
+    CCSPluginRelations *r = getPluginRelations (context, feature);
+    CCSPluginConflict  *conflict;
+    CCSPluginSeq       plugins = { NULL, NULL, 0 };
+    CCSPluginList      pl;
+
+    if (!r || !r->activeProviders)
+	return NULL;
+
+    conflict = calloc (1, sizeof (CCSPluginConflict));
+    if (!conflict)
+	return NULL;
+
+    for (pl = r->providers.head; pl; pl = pl->next)
+    {
+	PLUGIN_PRIV (pl->data);
+
+	if (pPrivate->active)
+	    ccsPluginSeqAppend (&plugins, pl->data);
+    }
+
+    conflict->value = strdup (feature);
+    conflict->type = type;
+    conflict->plugins = plugins.head;
+
+    return conflict;
+}
+
 CCSPluginConflictList
 ccsCanEnablePlugin (CCSContext * context, CCSPlugin * plugin)
 {
     CCSPluginConflictList list = NULL;
-    CCSPluginList pl, pl2;
+    CCSPluginConflict *conflict;
+    CCSPluginRelations *r;
+    CCSPluginList pl;
     CCSStringList sl;
 
     /* look if the plugin to be loaded requires a plugin not present */
@@ -2074,144 +3487,47 @@ ccsCanEnablePlugin (CCSContext * context, CCSPlugin * plugin)
     }
 
     /* look if the new plugin wants a non-present feature */
-    sl = plugin->requiresFeature;
-
-    while (sl)
+    for (sl = plugin->requiresFeature; sl; sl = sl->next)
     {
-	pl = context->plugins;
-	pl2 = NULL;
-
-	while (pl)
-	{
-	    CCSStringList featureList = pl->data->providesFeature;
-
-	    while (featureList)
-	    {
-		if (strcmp (sl->data, featureList->data) == 0)
-		{
-		    pl2 = ccsPluginListAppend (pl2, pl->data);
-		    break;
-		}
-		featureList = featureList->next;
-	    }
-
-	    pl = pl->next;
-	}
-
-	pl = pl2;
+	CCSPluginSeq providers = { NULL, NULL, 0 };
 
-	while (pl)
-	{
-	    if (ccsPluginIsActive (context, pl->data->name))
-	    {
-		ccsPluginListFree (pl2, FALSE);
-		break;
-	    }
-	    pl = pl->next;
-	}
+	r = getPluginRelations (context, sl->data);
+	if (r && r->activeProviders)
+	    continue;
 
-	if (!pl)
-	{
-	    /* no plugin provides that feature */
-	    CCSPluginConflict *conflict = calloc (1,
-						  sizeof (CCSPluginConflict));
+	/* no active plugin provides that feature */
+	conflict = calloc (1, sizeof (CCSPluginConflict));
+	if (!conflict)
+	    continue;
 
-	    if (conflict)
-	    {
-		conflict->value = strdup (sl->data);
-		conflict->type = ConflictRequiresFeature;
-		conflict->plugins = pl2;
+	/* each provider once, mentions of one plugin are adjacent */
+	for (pl = r ? r->providers.head : NULL; pl; pl = pl->next)
+	    if (!providers.tail || providers.tail->data != pl->data)
+		ccsPluginSeqAppend (&providers, pl->data);
 
-		list = ccsPluginConflictListAppend (list, conflict);
-	    }
-	}
+	conflict->value = strdup (sl->data);
+	conflict->type = ConflictRequiresFeature;
+	conflict->plugins = providers.head;
 
-	sl = sl->next;
+	list = ccsPluginConflictListAppend (list, conflict);
     }
 
     /* look if another plugin provides the same feature */
-    sl = plugin->providesFeature;
-    while (sl)
+    for (sl = plugin->providesFeature; sl; sl = sl->next)
     {
-	pl = context->plugins;
-	CCSPluginConflict *conflict = NULL;
-
-	while (pl)
-	{
-	    if (ccsPluginIsActive (context, pl->data->name))
-	    {
-		CCSStringList featureList = pl->data->providesFeature;
-
-		while (featureList)
-		{
-		    if (strcmp (sl->data, featureList->data) == 0)
-		    {
-			if (!conflict)
-			{
-			    conflict = calloc (1, sizeof (CCSPluginConflict));
-			    if (conflict)
-			    {
-				conflict->value = strdup (sl->data);
-				conflict->type = ConflictFeature;
-			    }
-			}
-			if (conflict)
-			    conflict->plugins =
-				ccsPluginListAppend (conflict->plugins,
-						     pl->data);
-		    }
-		    featureList = featureList->next;
-		}
-	    }
-	    pl = pl->next;
-	}
-
+	conflict = activeProvidersConflict (context, sl->data,
+					    ConflictFeature);
 	if (conflict)
 	    list = ccsPluginConflictListAppend (list, conflict);
-
-	sl = sl->next;
     }
 
     /* look if another plugin provides a conflicting feature*/
-    sl = plugin->conflictFeature;
-    while (sl)
+    for (sl = plugin->conflictFeature; sl; sl = sl->next)
     {
-	pl = context->plugins;
-	CCSPluginConflict *conflict = NULL;
-
-	while (pl)
-	{
-	    if (ccsPluginIsActive (context, pl->data->name))
-	    {
-		CCSStringList featureList = pl->data->providesFeature;
-		while (featureList)
-		{
-		    if (strcmp (sl->data, featureList->data) == 0)
-		    {
-			if (!conflict)
-			{
-			    conflict = calloc (1, sizeof (CCSPluginConflict));
-			    if (conflict)
-			    {
-				conflict->value = strdup (sl->data);
-				conflict->type = ConflictFeature;
-			    }
-			}
-			if (conflict)
-			    conflict->plugins =
-				ccsPluginListAppend (conflict->plugins,
-						     pl->data);
-		    }
-		    featureList = featureList->next;
-		}
-	    }
-	    pl = pl->next;
-	}
-
+	conflict = activeProvidersConflict (context, sl->data,
+					    ConflictFeature);
 	if (conflict)
 	    list = ccsPluginConflictListAppend (list, conflict);
-
-	sl = sl->next;
     }
 
     /* look if the plugin to be loaded conflict with a loaded plugin  */
@@ -2240,104 +3556,106 @@ ccsCanEnablePlugin (CCSContext * context, CCSPlugin * plugin)
     return list;
 }
 
+/* Returns a conflict of the given type listing the active plugins other
+   than plugin in users, or NULL if there are none */
+static CCSPluginConflict *
+activeUsersConflict (CCSPlugin             *plugin,
+		     CCSPluginList         users,
+		     const char            *value,
+		     CCSPluginConflictType type)
+{
+    CCSPluginConflict *conflict;
+    CCSPluginSeq      plugins = { NULL, NULL, 0 };
+
+    for (; users; users = users->next)
+    {
+	PLUGIN_PRIV (users->data);
+
+	if (users->data != plugin && pPrivate->active)
+	    ccsPluginSeqAppend (&plugins, users->data);
+    }
+
+    if (!plugins.head)
+	return NULL;
+
+    conflict = calloc (1, sizeof (CCSPluginConflict));
+    if (!conflict)
+    {
+	ccsPluginSeqFree (&plugins, FALSE);
+	return NULL;
+    }
+
+    conflict->value = strdup (value);
+    conflict->type = type;
+    conflict->plugins = plugins.head;
+
+    return conflict;
+}
+
 CCSPluginConflictList
 ccsCanDisablePlugin (CCSContext * context, CCSPlugin * plugin)
 {
     CCSPluginConflictList list = NULL;
     CCSPluginConflict *conflict = NULL;
-    CCSPluginList pl;
+    CCSPluginRelations *r;
     CCSStringList sl;
 
     /* look if the plugin to be unloaded is required by another plugin */
-    pl = context->plugins;
+    r = getPluginRelations (context, plugin->name);
+    if (r)
+	conflict = activeUsersConflict (plugin, r->dependents.head,
+					plugin->name, ConflictPluginNeeded);
+    if (conflict)
+	list = ccsPluginConflictListAppend (list, conflict);
 
-    for (; pl; pl = pl->next)
+    /* look if a feature provided is required by another plugin */
+    for (sl = plugin->providesFeature; sl; sl = sl->next)
     {
-	CCSStringList pluginList;
-
-	if (pl->data == plugin)
+	r = getPluginRelations (context, sl->data);
+	if (!r)
 	    continue;
 
-	if (!ccsPluginIsActive (context, pl->data->name))
-	    continue;
+	conflict = activeUsersConflict (plugin, r->featureUsers.head,
+					sl->data, ConflictFeatureNeeded);
+	if (conflict)
+	    list = ccsPluginConflictListAppend (list, conflict);
+    }
 
-	pluginList = pl->data->requiresPlugin;
+    return list;
+}
 
-	while (pluginList)
-	{
-	    if (strcmp (plugin->name, pluginList->data) == 0)
-	    {
-		if (!conflict)
-		{
-		    conflict = calloc (1, sizeof (CCSPluginConflict));
-		    if (conflict)
-		    {
-			conflict->value = strdup (plugin->name);
-			conflict->type = ConflictPluginNeeded;
-		    }
-		}
-
-		if (conflict)
-		    conflict->plugins =
-			ccsPluginListAppend (conflict->plugins, pl->data);
-		break;
-	    }
-	    pluginList = pluginList->next;
-	}
-    }
+CCSPluginConflictStatusList
+ccsGetPluginConflictStatus (CCSContext * context)
+{
+    CCSPluginConflictStatusSeq rv = { NULL, NULL, 0 };
+    CCSPluginList              pl;
 
-    if (conflict)
+    for (pl = context->plugins; pl; pl = pl->next)
     {
-	list = ccsPluginConflictListAppend (list, conflict);
-	conflict = NULL;
-    }
+	CCSPluginConflictStatus *status;
 
-    /* look if a feature provided is required by another plugin */
-    sl = plugin->providesFeature;
-    while (sl)
-    {
-	pl = context->plugins;
-	for (; pl; pl = pl->next)
-	{
-	    CCSStringList pluginList;
+	PLUGIN_PRIV (pl->data);
 
-	    if (pl->data == plugin)
-		continue;
+	status = calloc (1, sizeof (CCSPluginConflictStatus));
+	if (!status)
+	    return rv.head;
 
-	    if (!ccsPluginIsActive (context, pl->data->name))
-		continue;
+	status->plugin = pl->data;
+	status->active = pPrivate->active;
 
-	    pluginList = pl->data->requiresFeature;
+	if (pPrivate->active)
+	    status->conflicts = ccsCanDisablePlugin (context, pl->data);
+	else
+	    status->conflicts = ccsCanEnablePlugin (context, pl->data);
 
-	    while (pluginList)
-	    {
-		if (strcmp (sl->data, pluginList->data) == 0)
-		{
-		    if (!conflict)
-		    {
-			conflict = calloc (1, sizeof (CCSPluginConflict));
-
-			if (conflict)
-			{
-			    conflict->value = strdup (sl->data);
-			    conflict->type = ConflictFeatureNeeded;
-			}
-		    }
-		    if (conflict)
-			conflict->plugins =
-			    ccsPluginListAppend (conflict->plugins, pl->data);
-		}
-		pluginList = pluginList->next;
-	    }
-	    
+	if (!ccsPluginConflictStatusSeqAppend (&rv, status))
+	{
+	    ccsFreePluginConflictStatus (status);
+	    return rv.head;
 	}
-	if (conflict)
-	    list = ccsPluginConflictListAppend (list, conflict);
-	conflict = NULL;
-	sl = sl->next;
     }
 
-    return list;
+    return rv.head;
 }
 
 CCSStringList
@@ -2537,77 +3855,14 @@ ccsExportToFile (CCSContext *context,
 	if (!pPrivate->loaded)
 	    ccsLoadPluginSettings (plugin);
 
-	for (s = pPrivate->settings; s; s = s->next)
+	for (s = pPrivate->settings.head; s; s = s->next)
 	{
-	    char *keyName;
-
 	    setting = s->data;
 
 	    if (skipDefaults && setting->isDefault)
 		continue;
 
-	    if (setting->isScreen)
-	    {
-		keyName = strdup_printf ("s%d_%s",
-		                         setting->screenNum, setting->name);
-	    }
-	    else
-		keyName = strdup_printf ("as_%s", setting->name);
-
-	    if (keyName == NULL)
-		continue;
-
-	    switch (setting->type)
-	    {
-	    case TypeBool:
-		ccsIniSetBool (exportFile, plugin->name, keyName,
-			       setting->value->value.asBool);
-		break;
-	    case TypeInt:
-		ccsIniSetInt (exportFile, plugin->name, keyName,
-			      setting->value->value.asInt);
-		break;
-	    case TypeFloat:
-		ccsIniSetFloat (exportFile, plugin->name, keyName,
-				setting->value->value.asFloat);
-		break;
-	    case TypeString:
-		ccsIniSetString (exportFile, plugin->name, keyName,
-				 setting->value->value.asString);
-		break;
-	    case TypeKey:
-		ccsIniSetKey (exportFile, plugin->name, keyName,
-			      setting->value->value.asKey);
-		break;
-	    case TypeButton:
-		ccsIniSetButton (exportFile, plugin->name, keyName,
-				 setting->value->value.asButton);
-		break;
-	    case TypeEdge:
-		ccsIniSetEdge (exportFile, plugin->name, keyName,
-			       setting->value->value.asEdge);
-		break;
-	    case TypeBell:
-		ccsIniSetBell (exportFile, plugin->name, keyName,
-			       setting->value->value.asBell);
-		break;
-	    case TypeColor:
-		ccsIniSetColor (exportFile, plugin->name, keyName,
-				setting->value->value.asColor);
-		break;
-	    case TypeMatch:
-		ccsIniSetString (exportFile, plugin->name, keyName,
-				 setting->value->value.asMatch);
-		break;
-	    case TypeList:
-		ccsIniSetList (exportFile, plugin->name, keyName,
-			       setting->value->value.asList,
-			       setting->info.forList.listType);
-		break;
-	    default:
-		break;
-	    }
-	    free (keyName);
+	    ccsIniWriteSetting (exportFile, setting);
 	}
     }
 
@@ -2647,138 +3902,13 @@ ccsImportFromFile (CCSContext *context,
 	if (!pPrivate->loaded)
 	    ccsLoadPluginSettings (plugin);
 
-	for (s = pPrivate->settings; s; s = s->next)
+	for (s = pPrivate->settings.head; s; s = s->next)
 	{
-	    char *keyName;
-
 	    setting = s->data;
 	    if (!setting->isDefault && !overwriteNonDefault)
 		continue;
 
-	    if (setting->isScreen)
-	    {
-		keyName = strdup_printf ("s%d_%s",
-		                         setting->screenNum, setting->name);
-	    }
-	    else
-		keyName = strdup_printf ("as_%s", setting->name);
-
-	    if (keyName == NULL)
-		continue;
-
-	    switch (setting->type)
-	    {
-	    case TypeBool:
-		{
-		    Bool value;
-
-		    if (ccsIniGetBool (importFile, plugin->name,
-				       keyName, &value))
-			ccsSetBool (setting, value);
-		}
-		break;
-	    case TypeInt:
-		{
-		    int value;
-
-		    if (ccsIniGetInt (importFile, plugin->name,
-				      keyName, &value))
-			ccsSetInt (setting, value);
-		}
-		break;
-	    case TypeFloat:
-		{
-		    float value;
-
-		    if (ccsIniGetFloat (importFile, plugin->name,
-					keyName, &value))
-			ccsSetFloat (setting, value);
-		}
-		break;
-	    case TypeString:
-		{
-		    char *value;
-
-		    if (ccsIniGetString (importFile, plugin->name,
-					 keyName, &value))
-		    {
-		    	ccsSetString (setting, value);
-		    	free (value);
-		    }
-		}
-		break;
-	    case TypeKey:
-		{
-		    CCSSettingKeyValue value;
-
-		    if (ccsIniGetKey (importFile, plugin->name,
-				      keyName, &value))
-			ccsSetKey (setting, value);
-		}
-		break;
-	    case TypeButton:
-		{
-		    CCSSettingButtonValue value;
-
-		    if (ccsIniGetButton (importFile, plugin->name,
-					 keyName, &value))
-			ccsSetButton (setting, value);
-		}
-		break;
-	    case TypeEdge:
-		{
-		    unsigned int value;
-
-		    if (ccsIniGetEdge (importFile, plugin->name,
-				       keyName, &value))
-			ccsSetEdge (setting, value);
-		}
-		break;
-	    case TypeBell:
-		{
-		    Bool value;
-
-		    if (ccsIniGetBell (importFile, plugin->name,
-				       keyName, &value))
-			ccsSetBell (setting, value);
-		}
-		break;
-	    case TypeColor:
-		{
-		    CCSSettingColorValue value;
-
-		    if (ccsIniGetColor (importFile, plugin->name,
-					keyName, &value))
-			ccsSetColor (setting, value);
-		}
-		break;
-	    case TypeMatch:
-		{
-		    char *value;
-		    if (ccsIniGetString (importFile, plugin->name,
-					 keyName, &value))
-		    {
-		    	ccsSetMatch (setting, value);
-		    	free (value);
-		    }
-		}
-		break;
-	    case TypeList:
-		{
-		    CCSSettingValueList value;
-		    if (ccsIniGetList (importFile, plugin->name,
-				       keyName, &value, setting))
-		    {
-			ccsSetList (setting, value);
-			ccsSettingValueListFree (value, TRUE);
-		    }
-		}
-		break;
-	    default:
-		break;
-	    }
-
-	    free (keyName);
+	    ccsIniReadSettingValue (importFile, setting);
 	}
     }
 
@@ -2795,7 +3925,7 @@ CCSSettingList ccsGetPluginSettings (CCSPlugin *plugin)
     if (!pPrivate->loaded)
 	ccsLoadPluginSettings (plugin);
 
-    return pPrivate->settings;
+    return pPrivate->settings.head;
 }
 
 CCSGroupList ccsGetPluginGroups (CCSPlugin *plugin)
@@ -2805,9 +3935,32 @@ CCSGroupList ccsGetPluginGroups (CCSPlugin *plugin)
     if (!pPrivate->loaded)
 	ccsLoadPluginSettings (plugin);
 
+    if (!pPrivate->groupsCollated)
+	pPrivate->groupsCollated = collateGroups (pPrivate);
+
     return pPrivate->groups;
 }
 
+const char *ccsSettingGetShortDesc (CCSSetting *setting)
+{
+    if (!setting)
+	return NULL;
+
+    ccsLoadPluginDescriptions (setting->parent);
+
+    return setting->shortDesc;
+}
+
+const char *ccsSettingGetLongDesc (CCSSetting *setting)
+{
+    if (!setting)
+	return NULL;
+
+    ccsLoadPluginDescriptions (setting->parent);
+
+    return setting->longDesc;
+}
+
 Bool ccsSettingIsIntegrated (CCSSetting *setting)
 {
     if (!setting)